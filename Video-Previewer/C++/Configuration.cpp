@@ -22,10 +22,60 @@ const std::unordered_map<string, OptionInformation> ConfigOption::recognisedOpti
                                              ValidOptionValue::eDecimalOrAuto,
                                              std::make_shared<ConfigValueDouble>(0.5) ) },
     
+    {"sampling_mode",      OptionInformation("How frames are sampled from the video. \"exact\" samples evenly spaced frames. \"keyframe\" moves each sample to the nearest keyframe, which is much faster to decode",
+                                             ValidOptionValue::eString,
+                                             vector<string>{ "exact", "keyframe" },
+                                             std::make_shared<ConfigValueString>("exact") ) },
+    
+    {"sampling_schedule",  OptionInformation("Where frames are sampled from. \"even\" samples exactly evenly spaced frames. \"nested\" samples frames so that most of them are still sampled when the number of frames changes, so they don't need to be decoded again (the gaps between frames differ by up to a factor of 2)",
+                                             ValidOptionValue::eString,
+                                             vector<string>{ "even", "nested" },
+                                             std::make_shared<ConfigValueString>("even") ) },
+    
+    {"decode_engine",      OptionInformation("How frames are decoded. \"seek\" seeks to each frame. \"sequential\" decodes straight through the video. \"fast_scan\" decodes keyframes only (implies sampling at keyframes), without decoding any of the frames between them. \"auto\" chooses between seeking and decoding straight through for each frame, based on how long each takes for the video",
+                                             ValidOptionValue::eString,
+                                             vector<string>{ "auto", "seek", "sequential", "fast_scan" },
+                                             std::make_shared<ConfigValueString>("auto") ) },
+    
+    {"video_backend",      OptionInformation("The library used to read the video. \"libav\" uses libavformat and libavcodec directly (if Video-Previewer was built with them), and otherwise OpenCV is used. Takes effect when the video is next opened",
+                                             ValidOptionValue::eString,
+                                             vector<string>{ "opencv", "libav" },
+                                             std::make_shared<ConfigValueString>("opencv") ) },
+    
+    {"default_fps",        OptionInformation("The frame rate of videos that don't record one themselves: image sequences (a directory of numbered images, or a pattern such as \"shot_%04d.png\") and raw .yuv files, as well as video tracks without a frame rate when using the \"libav\" backend",
+                                             ValidOptionValue::ePositiveInteger,
+                                             std::make_shared<ConfigValueInt>(24) ) },
+    
+    {"progressive_preview", OptionInformation("Whether to show a rough preview (made from keyframes near some of the frames) straight away, and fill in the actual frames in the background",
+                                             ValidOptionValue::eBoolean,
+                                             std::make_shared<ConfigValueBool>(false) ) },
+    
+    {"extraction_threads", OptionInformation("The number of threads used to extract frames, each decoding its own part of the video. \"auto\" uses one thread per processor core (up to 8)",
+                                             ValidOptionValue::ePositiveIntegerOrAuto,
+                                             std::make_shared<ConfigValueString>("auto") ) },
+    
+    {"time_budget_ms",     OptionInformation("How long (in milliseconds) to spend making the preview. Frames are decoded in an order that covers the whole video as evenly as possible at every point, so whatever has been decoded when the time runs out is spread through the video; the rest are then decoded in the background. \"none\" decodes every frame. Takes precedence over \"progressive_preview\"",
+                                             ValidOptionValue::ePositiveIntegerOrString,
+                                             vector<string>{ "none" },
+                                             std::make_shared<ConfigValueString>("none") ) },
+    
+    {"decode_timeout_ms",  OptionInformation("How long (in milliseconds) to wait for any one frame to be decoded before giving up on it, so that a damaged part of a video can't hold up the whole preview. A frame that is given up on is replaced by the next keyframe (if that comes before the next frame in the preview), and otherwise left empty. \"none\" waits for as long as it takes",
+                                             ValidOptionValue::ePositiveIntegerOrString,
+                                             vector<string>{ "none" },
+                                             std::make_shared<ConfigValueString>("none") ) },
+    
+    {"prefetch_window",    OptionInformation("The number of frames either side of the selected frame that are decoded in the background, so that stepping between neighbouring frames is instant",
+                                             ValidOptionValue::ePositiveInteger,
+                                             std::make_shared<ConfigValueInt>(12) ) },
+    
     {"frame_size",         OptionInformation("Size of the frames in the preview. Value between 0 (smallest) and 1 (largest).",
                                              ValidOptionValue::eDecimal,
                                              std::make_shared<ConfigValueDouble>(0.25) ) },
     
+    {"thumbnail_width",    OptionInformation("The width (in pixels) that frames are stored at once they have been decoded. \"auto\" uses the width of the largest frames the preview can show, so that changing \"frame_size\" never needs the frames to be decoded again",
+                                             ValidOptionValue::ePositiveIntegerOrAuto,
+                                             std::make_shared<ConfigValueString>("auto") ) },
+    
     {"overlay_timestamp",  OptionInformation("Whether to overlay the timestamp of each frame in the preview",
                                              ValidOptionValue::eBoolean,
                                              std::make_shared<ConfigValueBool>(true) ) },
@@ -325,7 +375,10 @@ void ConfigOptionsHandler::saveOptions(ConfigOptionVector optionsToSave, const C
 void ConfigOptionsHandler::loadOptions(const string& videoPath)
 {
     // Remove the name of the video file from videoPath, to isolate the directory it is in
-    string localDir = videoPath.substr(0,videoPath.find_last_of("\\/"));
+    // Paths without a directory (e.g. synthetic videos) have no local config files
+    auto parentDirectory = [](const string& path) { size_t separator = path.find_last_of("\\/"); return separator == string::npos ? string{} : path.substr(0,separator); };
+    
+    string localDir = parentDirectory(videoPath);
     string localConfigFilePath;
 
     // Scan through all directories between that containing the video and the user home
@@ -335,7 +388,7 @@ void ConfigOptionsHandler::loadOptions(const string& videoPath)
         localConfigFilePath = localDir + "/.videopreviewconfig";
         if (fs::exists(localConfigFilePath))
             configFiles.push_back( std::make_shared<ConfigFile>(localConfigFilePath) ); // Load local config files
-        localDir = localDir.substr(0,localDir.find_last_of("\\/"));
+        localDir = parentDirectory(localDir);
     }
     
     string userConfigFilePath = string(std::getenv("HOME")) + "/.config/videopreview";
@@ -0,0 +1,484 @@
+#include "ContainerIndex.hpp"
+
+#include <numeric>    // for std::iota
+#include <algorithm>  // for std::sort, std::lower_bound
+#include <filesystem> // for std::filesystem::last_write_time()
+#include <map>        // for std::map
+#include <mutex>      // for std::mutex
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Functions
+   ----------------------------------------------------------------------------------------------------*/
+
+// Boxes store all integers in big-endian byte order
+static uint32_t readUInt32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]); }
+static uint64_t readUInt64(const uint8_t* p) { return (uint64_t(readUInt32(p)) << 32) | readUInt32(p + 4); }
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ContainerIndex
+   ----------------------------------------------------------------------------------------------------*/
+
+ContainerIndex::ContainerIndex(const string& filePathIn) : filePath{ filePathIn }
+{
+    try
+    {
+        readMovieBox();
+        parseMovieBox();
+        valid = !keyframes.empty();
+    }
+    catch (const FileException& exception)
+    {
+        std::cerr << exception.what();
+        valid = false;
+    }
+
+    moovData.clear();
+    moovData.shrink_to_fit();
+}
+
+ContainerIndexPtr ContainerIndex::load(const string& filePath)
+{
+    struct CachedIndex
+    {
+        std::filesystem::file_time_type modified;
+        uintmax_t                       size;
+        ContainerIndexPtr               index;
+    };
+
+    const static size_t maxCachedIndexes = 8;
+
+    static std::mutex                    cacheMutex;
+    static std::map<string, CachedIndex> cache;
+
+    std::error_code                 error;
+    std::filesystem::file_time_type modified { std::filesystem::last_write_time(filePath, error) };
+    uintmax_t                       size     { std::filesystem::file_size(filePath, error) };
+
+    {
+        std::lock_guard<std::mutex> lock { cacheMutex };
+
+        auto cached = cache.find(filePath);
+        if (cached != cache.end() && !error && cached->second.modified == modified && cached->second.size == size)
+            return cached->second.index;
+    }
+
+    // Built without holding the lock, so indexing one file doesn't hold up opening another
+    ContainerIndexPtr index { std::make_shared<const ContainerIndex>(filePath) };
+
+    std::lock_guard<std::mutex> lock { cacheMutex };
+
+    // Forget the indexes of files that are no longer open, rather than letting the cache grow forever
+    if (cache.size() >= maxCachedIndexes)
+        for (auto cached = cache.begin(); cached != cache.end(); )
+            cached = cached->second.index.use_count() == 1 ? cache.erase(cached) : std::next(cached);
+
+    if (!error)
+        cache[filePath] = CachedIndex{ modified, size, index };
+
+    return index;
+}
+
+int ContainerIndex::getFrameAtSeconds(const double seconds) const
+{
+    if (!hasTimestamps())
+        return 0;
+
+    const double tolerance = 1e-6; // So that rounding errors in `seconds` don't land on the frame before
+
+    auto next = std::upper_bound(frameSeconds.begin(), frameSeconds.end(), seconds + tolerance); // First frame starting after `seconds`
+    return (next == frameSeconds.begin()) ? 0 : static_cast<int>(next - frameSeconds.begin()) - 1;
+}
+
+int ContainerIndex::getNearestKeyframe(const int frameNumber) const
+{
+    if (!valid)
+        return frameNumber;
+
+    auto next = std::lower_bound(keyframes.begin(), keyframes.end(), frameNumber); // First keyframe at or after frameNumber
+
+    if (next == keyframes.begin())
+        return *next;
+    if (next == keyframes.end())
+        return keyframes.back();
+
+    auto previous = next - 1;
+    return (frameNumber - *previous <= *next - frameNumber) ? *previous : *next;
+}
+
+int ContainerIndex::getPreviousKeyframe(const int frameNumber) const
+{
+    if (!valid)
+        return -1;
+
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), frameNumber); // First keyframe after frameNumber
+    return (next == keyframes.begin()) ? -1 : *(next - 1);
+}
+
+bool ContainerIndex::isKeyframe(const int frameNumber) const
+{
+    return valid && std::binary_search(keyframes.begin(), keyframes.end(), frameNumber);
+}
+
+void ContainerIndex::readMovieBox()
+{
+    std::ifstream file{ filePath, std::ios::binary };
+    if (!file)
+        throw FileException("could not open file for indexing\n", filePath);
+
+    file.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(std::max<std::streamoff>(file.tellg(), 0));
+    file.seekg(0, std::ios::beg);
+
+    // Walk the top level boxes until "moov" is found. Only box headers are read, so this is
+    // cheap even when the (potentially huge) "mdat" box comes before "moov"
+    uint8_t header[16];
+    while (file.read(reinterpret_cast<char*>(header), 8))
+    {
+        uint64_t size       = readUInt32(header);
+        string   type       { reinterpret_cast<char*>(header + 4), 4 };
+        uint64_t headerSize = 8;
+
+        if (size == 1) // 64 bit "largesize" follows the type
+        {
+            if (!file.read(reinterpret_cast<char*>(header + 8), 8))
+                return;
+            size       = readUInt64(header + 8);
+            headerSize = 16;
+        }
+
+        if (type == "moov")
+        {
+            if (size == 0 || size < headerSize) // A size of 0 means the box extends to the end of the file
+                return;
+
+            // Checked before anything is allocated, so that a damaged size can't ask for more memory than the file could fill
+            const uint64_t remaining = fileSize - std::min<uint64_t>(static_cast<uint64_t>(file.tellg()), fileSize);
+            if (size - headerSize > remaining)
+                throw FileException("\"moov\" box is larger than the rest of the file\n", filePath);
+
+            moovData.resize(size - headerSize);
+            if (!file.read(reinterpret_cast<char*>(moovData.data()), moovData.size()))
+                throw FileException("file ends part way through the \"moov\" box\n", filePath);
+            return;
+        }
+
+        // Files that aren't ISO base media files will (almost certainly) fail this check straight away
+        if (size == 0 || size < headerSize)
+            return;
+
+        file.seekg(size - headerSize, std::ios::cur);
+    }
+}
+
+void ContainerIndex::parseMovieBox()
+{
+    if (moovData.empty())
+        return;
+
+    Box moov { "moov", moovData.data(), moovData.size() };
+
+    for (const Box& trak : getChildBoxes(moov.data, moov.size))
+    {
+        if (trak.type != "trak")
+            continue;
+
+        Box mdia = findChildBox(trak, "mdia");
+        Box hdlr = findChildBox(mdia, "hdlr");
+
+        // hdlr: version & flags (4 bytes), pre_defined (4 bytes), handler_type (4 bytes)
+        if (hdlr.size < 12 || string(reinterpret_cast<const char*>(hdlr.data + 8), 4) != "vide")
+            continue;
+
+        Box stbl = findChildBox(findChildBox(mdia, "minf"), "stbl");
+        if (stbl.type.empty())
+            continue;
+
+        timescale = parseTimescale(findChildBox(mdia, "mdhd"));
+        parseEditList(findChildBox(findChildBox(trak, "edts"), "elst"), parseTimescale(findChildBox(moov, "mvhd")));
+        parseSampleTable(stbl);
+        parseSampleLocations(stbl);
+        
+        trackHeaderBox       = copyBox(findChildBox(trak, "tkhd"));
+        sampleDescriptionBox = copyBox(findChildBox(stbl, "stsd"));
+        return; // Only the first video track is indexed
+    }
+}
+
+uint32_t ContainerIndex::parseTimescale(const Box& header)
+{
+    // mvhd/mdhd: version & flags (4), then creation and modification times (4 bytes each in version 0, 8 in version 1), then timescale (4)
+    if (header.size < 4)
+        return 0;
+
+    const size_t timescaleOffset = (header.data[0] == 1) ? 20 : 12;
+    return (header.size >= timescaleOffset + 4) ? readUInt32(header.data + timescaleOffset) : 0;
+}
+
+void ContainerIndex::parseEditList(const Box& elst, const uint32_t movieTimescale)
+{
+    editStart = 0;
+    editEnd   = INT64_MAX;
+
+    // elst: version & flags (4), entry_count (4), then segment_duration and media_time (4 bytes each in version 0, 8 in version 1) and media_rate (4) for each edit
+    if (elst.size < 8)
+        return;
+
+    const bool     is64bit   = (elst.data[0] == 1);
+    const size_t   entrySize = is64bit ? 20 : 12;
+    const uint32_t entries   = readUInt32(elst.data + 4);
+
+    int shownEdits = 0;
+    for (uint32_t i = 0; i < entries && 8 + entrySize*(i+1) <= elst.size; ++i)
+    {
+        const uint8_t* entry     = elst.data + 8 + entrySize*i;
+        const uint64_t duration  = is64bit ? readUInt64(entry) : readUInt32(entry);
+        const int64_t  mediaTime = is64bit ? static_cast<int64_t>(readUInt64(entry + 8)) : static_cast<int32_t>(readUInt32(entry + 4));
+
+        if (mediaTime < 0) // An empty edit only delays the track, and times are counted from the first frame anyway
+            continue;
+
+        if (++shownEdits == 1)
+        {
+            editStart = mediaTime;
+            if (duration > 0 && movieTimescale > 0 && duration < INT64_MAX / std::max<uint32_t>(timescale, 1))
+                editEnd = mediaTime + static_cast<int64_t>(duration * timescale / movieTimescale);
+        }
+    }
+
+    // With several edits, all of the track from the first one onwards is shown (rather than the parts being reordered or repeated)
+    if (shownEdits > 1)
+        editEnd = INT64_MAX;
+}
+
+void ContainerIndex::parseSampleTable(const Box& stbl)
+{
+    Box stsz = findChildBox(stbl, "stsz");
+    Box stts = findChildBox(stbl, "stts");
+    Box ctts = findChildBox(stbl, "ctts");
+    Box stss = findChildBox(stbl, "stss");
+
+    // stsz: version & flags (4), sample_size (4), sample_count (4), ...
+    if (stsz.size < 12 || stts.size < 8)
+        throw FileException("video track has an incomplete sample table\n", filePath);
+
+    const uint32_t sampleCount = readUInt32(stsz.data + 8);
+
+    // The sample count is checked against the tables that describe each sample before anything is sized by it, so that a damaged count
+    // can't ask for more memory than the tables could fill
+    if (readUInt32(stsz.data + 4) == 0 && (stsz.size - 12) / 4 < sampleCount)
+        throw FileException("video track has more samples than sizes\n", filePath);
+    {
+        const uint32_t entries = readUInt32(stts.data + 4);
+        uint64_t       timed   = 0;
+        for (uint32_t i = 0; i < entries && 8 + 8*(i+1) <= stts.size; ++i)
+            timed += readUInt32(stts.data + 8 + 8*i);
+        if (timed < sampleCount)
+            throw FileException("video track has more samples than durations\n", filePath);
+    }
+
+    // Decode timestamp of each sample, from the (run length encoded) sample durations in stts
+    vector<int64_t>  timestamps;
+    vector<uint32_t> durations;
+    timestamps.reserve(sampleCount);
+    durations.reserve(sampleCount);
+    {
+        const uint32_t entries   = readUInt32(stts.data + 4);
+        int64_t        timestamp = 0;
+        for (uint32_t i = 0; i < entries && 8 + 8*(i+1) <= stts.size; ++i)
+        {
+            const uint32_t count    = readUInt32(stts.data + 8 + 8*i);
+            const uint32_t duration = readUInt32(stts.data + 8 + 8*i + 4);
+            for (uint32_t j = 0; j < count && timestamps.size() < sampleCount; ++j)
+            {
+                timestamps.push_back(timestamp);
+                durations.push_back(duration);
+                timestamp += duration;
+            }
+        }
+        while (timestamps.size() < sampleCount)
+        {
+            timestamps.push_back(timestamp);
+            durations.push_back(0);
+        }
+    }
+
+    // Composition offsets turn decode timestamps into presentation timestamps (only present when frames are reordered, e.g. B-frames)
+    if (ctts.size >= 8)
+    {
+        const uint32_t entries = readUInt32(ctts.data + 4);
+        size_t         sample  = 0;
+        for (uint32_t i = 0; i < entries && 8 + 8*(i+1) <= ctts.size; ++i)
+        {
+            const uint32_t count  = readUInt32(ctts.data + 8 + 8*i);
+            const int32_t  offset = static_cast<int32_t>(readUInt32(ctts.data + 8 + 8*i + 4)); // Signed in version 1, and in practice in version 0 too
+            for (uint32_t j = 0; j < count && sample < sampleCount; ++j)
+                timestamps[sample++] += offset;
+        }
+    }
+
+    // Sync sample table (1-based sample numbers). If it isn't present every sample is a keyframe
+    keyframeFlags.assign(sampleCount, stss.type.empty());
+    if (stss.size >= 8)
+    {
+        const uint32_t entries = readUInt32(stss.data + 4);
+        for (uint32_t i = 0; i < entries && 8 + 4*(i+1) <= stss.size; ++i)
+        {
+            const uint32_t sample = readUInt32(stss.data + 8 + 4*i);
+            if (sample >= 1 && sample <= sampleCount)
+                keyframeFlags[sample - 1] = true;
+        }
+    }
+
+    // OpenCV numbers frames in presentation order, so rank each sample by its presentation timestamp
+    vector<uint32_t> samples(sampleCount);
+    std::iota(samples.begin(), samples.end(), 0);
+    std::stable_sort(samples.begin(), samples.end(), [&](uint32_t a, uint32_t b) { return timestamps[a] < timestamps[b]; });
+
+    // Samples outside the edit are decoded (as frames shown may depend on them) but dropped, so they aren't frames
+    presentationOrder.clear();
+    for (uint32_t sample : samples)
+        if (timestamps[sample] >= editStart && timestamps[sample] < editEnd)
+            presentationOrder.push_back(sample);
+
+    if (presentationOrder.empty()) // An edit list that doesn't match the samples is more likely to be broken than to hide every frame
+        presentationOrder = samples;
+
+    keyframes.clear();
+    for (uint32_t frameNumber = 0; frameNumber < presentationOrder.size(); ++frameNumber)
+        if (keyframeFlags[presentationOrder[frameNumber]])
+            keyframes.push_back(frameNumber);
+
+    // Presentation time of each frame, counted from the first frame (as OpenCV does)
+    frameSeconds.clear();
+    durationSeconds = 0.0;
+    if (timescale == 0 || presentationOrder.empty())
+        return;
+
+    const int64_t firstTimestamp = timestamps[presentationOrder.front()];
+    const int64_t lastTimestamp  = timestamps[presentationOrder.back()];
+
+    frameSeconds.reserve(presentationOrder.size());
+    for (uint32_t sample : presentationOrder)
+        frameSeconds.push_back(static_cast<double>(timestamps[sample] - firstTimestamp) / timescale);
+
+    // The last frame is cut short if the edit ends part way through it
+    const int64_t lastDuration = std::min<int64_t>(durations[presentationOrder.back()], std::max<int64_t>(editEnd - lastTimestamp, 0));
+    durationSeconds = frameSeconds.back() + static_cast<double>(lastDuration) / timescale;
+}
+
+void ContainerIndex::parseSampleLocations(const Box& stbl)
+{
+    Box stsz = findChildBox(stbl, "stsz");
+    Box stsc = findChildBox(stbl, "stsc");
+    Box stco = findChildBox(stbl, "stco");
+    Box co64 = findChildBox(stbl, "co64");
+
+    const size_t sampleCount = keyframeFlags.size();
+    if (stsc.size < 8 || (stco.size < 8 && co64.size < 8))
+        return; // The sample locations are only needed by some decode engines, so they are allowed to be missing
+
+    // Sample sizes: either a single size for every sample, or a table
+    const uint32_t constantSize = readUInt32(stsz.data + 4);
+    sampleSizes.assign(sampleCount, constantSize);
+    if (constantSize == 0)
+    {
+        if (stsz.size < 12 + 4*sampleCount)
+            return;
+        for (size_t i = 0; i < sampleCount; ++i)
+            sampleSizes[i] = readUInt32(stsz.data + 12 + 4*i);
+    }
+
+    // Chunk offsets: 32 bit ("stco") or 64 bit ("co64")
+    vector<uint64_t> chunkOffsets;
+    {
+        const bool     is64bit = (co64.size >= 8);
+        const Box&     table   = is64bit ? co64 : stco;
+        const uint32_t entries = readUInt32(table.data + 4);
+        const size_t   width   = is64bit ? 8 : 4;
+        for (uint32_t i = 0; i < entries && 8 + width*(i+1) <= table.size; ++i)
+            chunkOffsets.push_back(is64bit ? readUInt64(table.data + 8 + 8*i) : readUInt32(table.data + 8 + 4*i));
+    }
+
+    // Sample to chunk: runs of chunks that each contain the same number of samples. Within a chunk, samples are stored contiguously
+    const uint32_t entries = readUInt32(stsc.data + 4);
+    sampleOffsets.clear();
+    sampleOffsets.reserve(sampleCount);
+    for (uint32_t i = 0; i < entries && 8 + 12*(i+1) <= stsc.size; ++i)
+    {
+        const uint32_t firstChunk      = readUInt32(stsc.data + 8 + 12*i);     // 1-based
+        const uint32_t samplesPerChunk = readUInt32(stsc.data + 8 + 12*i + 4);
+        const uint32_t lastChunk       = (i + 1 < entries && 8 + 12*(i+2) <= stsc.size) ? readUInt32(stsc.data + 8 + 12*(i+1)) - 1 : static_cast<uint32_t>(chunkOffsets.size());
+
+        for (uint32_t chunk = firstChunk; chunk <= lastChunk && chunk >= 1 && chunk <= chunkOffsets.size(); ++chunk)
+        {
+            uint64_t offset = chunkOffsets[chunk - 1];
+            for (uint32_t j = 0; j < samplesPerChunk && sampleOffsets.size() < sampleCount; ++j)
+            {
+                sampleOffsets.push_back(offset);
+                offset += sampleSizes[sampleOffsets.size() - 1];
+            }
+        }
+    }
+
+    if (sampleOffsets.size() != sampleCount)
+    {
+        sampleOffsets.clear();
+        sampleSizes.clear();
+    }
+}
+
+vector<ContainerIndex::Box> ContainerIndex::getChildBoxes(const uint8_t* data, const size_t size)
+{
+    vector<Box> boxes;
+    size_t      position = 0;
+
+    while (position + 8 <= size)
+    {
+        uint64_t boxSize    = readUInt32(data + position);
+        string   type       { reinterpret_cast<const char*>(data + position + 4), 4 };
+        uint64_t headerSize = 8;
+
+        if (boxSize == 1)
+        {
+            if (position + 16 > size)
+                break;
+            boxSize    = readUInt64(data + position + 8);
+            headerSize = 16;
+        }
+        else if (boxSize == 0)
+            boxSize = size - position;
+
+        if (boxSize < headerSize || boxSize > size - position)
+            break; // Malformed box; ignore the rest of the region
+
+        boxes.push_back(Box{ type, data + position + headerSize, static_cast<size_t>(boxSize - headerSize) });
+        position += boxSize;
+    }
+
+    return boxes;
+}
+
+vector<uint8_t> ContainerIndex::copyBox(const Box& box)
+{
+    if (box.type.empty() || box.size + 8 > UINT32_MAX)
+        return vector<uint8_t>{};
+
+    const uint32_t  size = static_cast<uint32_t>(box.size + 8);
+    vector<uint8_t> copy { uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size) };
+    copy.insert(copy.end(), box.type.begin(), box.type.end());
+    copy.insert(copy.end(), box.data, box.data + box.size);
+    return copy;
+}
+
+ContainerIndex::Box ContainerIndex::findChildBox(const Box& parent, const string& type)
+{
+    if (parent.type.empty())
+        return Box{ "", nullptr, 0 };
+
+    for (const Box& box : getChildBoxes(parent.data, parent.size))
+        if (box.type == type)
+            return box;
+
+    return Box{ "", nullptr, 0 };
+}
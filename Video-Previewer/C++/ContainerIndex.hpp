@@ -0,0 +1,139 @@
+#ifndef ContainerIndex_hpp
+#define ContainerIndex_hpp
+
+#include <iostream>
+#include <fstream>   // for std::ifstream
+#include <memory>    // for std::shared_ptr
+#include <vector>    // for std::vector
+#include <cstdint>   // for fixed width integer types
+
+#include "Exceptions.hpp"
+
+using std::string;
+using std::vector;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ContainerIndex
+        Information about the video track of a file that can be read directly from the container,
+        without decoding any frames. Currently only ISO base media files (.mp4, .mov, .m4v, ...) are
+        understood, as their sample tables describe every frame of the video track.
+
+        For any other container (or if the file can't be parsed) `isValid()` returns false, and the
+        caller is expected to fall back to whatever it would have done without the index.
+
+        The sample tables also give the presentation time of every frame, so (unlike the frame count
+        and frame rate reported by the decoder, which are estimates for variable frame rate video) the
+        index knows exactly how many frames there are and when each is shown.
+
+        As FFmpeg (and so OpenCV) does, samples before the start of the track's edit list are decoded
+        but never shown, so aren't counted as frames. Only the first edit that isn't empty is applied
+        (its end too, if it's the only one); files that repeat or reorder parts of the track with
+        several edits are rare, and their frames are numbered as if only that edit existed.
+   ----------------------------------------------------------------------------------------------------*/
+
+class ContainerIndex;
+using ContainerIndexPtr = std::shared_ptr<const ContainerIndex>;
+
+class ContainerIndex
+{
+public:
+    ContainerIndex() {};
+    ContainerIndex(const string& filePathIn);
+
+    // The index of `filePath`, which is only built the first time it's asked for (or when the file has changed since)
+    static ContainerIndexPtr load(const string& filePath);
+
+    bool               isValid()            const { return valid; }
+    // The number of frames shown, which is fewer than the number of samples if the edit list leaves some out
+    int                getNumberOfFrames()  const { return static_cast<int>(presentationOrder.size()); }
+
+    // Frame numbers (in presentation order, indexed from 0 as in OpenCV) of every keyframe in the video track
+    const vector<int>& getKeyframes()       const { return keyframes; }
+
+    // Return the frame number of the keyframe closest to `frameNumber`
+    // If the index isn't valid, `frameNumber` is returned unchanged
+    int                getNearestKeyframe(const int frameNumber) const;
+    bool               isKeyframe(const int frameNumber)         const;
+    
+    // Return the frame number of the last keyframe at or before `frameNumber`
+    // Returns -1 if the index isn't valid, or if there's no such keyframe (e.g. the leading frames of an open GOP, or of an edit that starts between keyframes)
+    int                getPreviousKeyframe(const int frameNumber) const;
+    
+    // The average number of frames between keyframes (0 if the index isn't valid)
+    double             getAverageKeyframeInterval()              const { return valid ? static_cast<double>(getNumberOfFrames()) / keyframes.size() : 0.0; }
+
+    // When each frame is shown, in seconds from the first frame
+    bool               hasTimestamps()                           const { return valid && !frameSeconds.empty(); }
+    double             getFrameSeconds(const int frameNumber)    const { return frameSeconds.at(frameNumber); }
+    double             getDurationSeconds()                      const { return durationSeconds; }
+
+    // Return the frame shown at `seconds`, i.e. the last frame that starts at or before then (clamped to the first and last frames)
+    int                getFrameAtSeconds(const double seconds)   const;
+
+    // Where the compressed data for the sample corresponding to `frameNumber` is stored in the file
+    // Samples are stored in decode order, so these are looked up through `getSampleNumber()`
+    int                getSampleNumber(const int frameNumber)    const { return static_cast<int>(presentationOrder.at(frameNumber)); }
+    uint64_t           getSampleOffset(const int sampleNumber)   const { return sampleOffsets.at(sampleNumber); }
+    uint32_t           getSampleSize(const int sampleNumber)     const { return sampleSizes.at(sampleNumber); }
+    bool               hasSampleLocations()                      const { return valid && sampleOffsets.size() == keyframeFlags.size(); }
+
+    // Raw copies of the boxes describing the video track, for writing the track (or parts of it) to a new file
+    // The sample description ("stsd") holds everything a decoder needs to be initialised (codec, dimensions, parameter sets)
+    const vector<uint8_t>& getSampleDescriptionBox() const { return sampleDescriptionBox; }
+    const vector<uint8_t>& getTrackHeaderBox()       const { return trackHeaderBox; }
+
+private:
+    // A single box (a.k.a. atom) in an ISO base media file. `data` points to the payload of the box (i.e. not including the header)
+    struct Box
+    {
+        string         type;
+        const uint8_t* data;
+        size_t         size;
+    };
+
+    // Read the payload of the top level "moov" box into `moovData`
+    void readMovieBox();
+
+    // Parse the sample table of the first video track found in `moovData`
+    void parseMovieBox();
+
+    // Read the number of time stamp units per second from a movie or media header ("mvhd" or "mdhd", which agree up to the timescale)
+    static uint32_t parseTimescale(const Box& header);
+
+    // Read the part of the track that is shown from its edit list ("elst"), converting the movie timescale to the track's
+    void parseEditList(const Box& elst, const uint32_t movieTimescale);
+
+    // Number the samples shown by the edit in presentation order, and find the keyframes and timestamps of those frames
+    void parseSampleTable(const Box& stbl);
+    
+    // Determine the position of each sample in the file from the chunk tables ("stsc" and "stco"/"co64")
+    void parseSampleLocations(const Box& stbl);
+
+    // Split a region of memory into the boxes it contains
+    static vector<Box> getChildBoxes(const uint8_t* data, const size_t size);
+
+    // Return the first child box of `parent` with the given type. The `type` of the returned box is empty if no such box exists
+    static Box         findChildBox(const Box& parent, const string& type);
+    
+    // Return a copy of `box` including its (8 byte) header
+    static vector<uint8_t> copyBox(const Box& box);
+
+private:
+    string           filePath             {};
+    vector<uint8_t>  moovData             {}; // The raw payload of the "moov" box
+    vector<bool>     keyframeFlags        {}; // Whether each sample (in decode order) is a keyframe
+    vector<int>      keyframes            {}; // See getKeyframes()
+    vector<uint32_t> presentationOrder    {}; // The sample number of each frame (i.e. maps presentation order to decode order)
+    uint32_t         timescale            = 0;  // Time stamp units per second
+    int64_t          editStart            = 0;  // The presentation timestamp of the first frame shown
+    int64_t          editEnd              = INT64_MAX; // The presentation timestamp after the last frame shown
+    vector<double>   frameSeconds         {}; // See getFrameSeconds(). Empty if the timescale is unknown
+    double           durationSeconds      = 0.0;
+    vector<uint64_t> sampleOffsets        {}; // The offset of each sample from the start of the file, in decode order
+    vector<uint32_t> sampleSizes          {}; // The size in bytes of each sample, in decode order
+    vector<uint8_t>  sampleDescriptionBox {}; // See getSampleDescriptionBox()
+    vector<uint8_t>  trackHeaderBox       {}; // See getTrackHeaderBox()
+    bool             valid                = false;
+};
+
+#endif /* ContainerIndex_hpp */
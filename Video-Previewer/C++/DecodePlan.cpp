@@ -0,0 +1,111 @@
+#include "DecodePlan.hpp"
+
+#include <algorithm> // for std::max, std::upper_bound
+#include <iomanip>   // for std::setprecision
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodeCostModel
+   ----------------------------------------------------------------------------------------------------*/
+
+int DecodeCostModel::getFramesDecodedBySeek(const int frameNumber, const ContainerIndex& index) const
+{
+    const int searchFrom = std::max(frameNumber - seekPreroll, 0);
+
+    // Frames before the first keyframe (e.g. the leading frames of an open GOP) are only reached by decoding from the start
+    if (index.isValid())
+        return frameNumber - std::max(index.getPreviousKeyframe(searchFrom), 0) + 1;
+
+    return std::min(frameNumber, seekPreroll + defaultKeyframeInterval/2) + 1;
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodePlan
+   ----------------------------------------------------------------------------------------------------*/
+
+DecodePlan::DecodePlan(const vector<int>& frameNumbers, const DecodeCostModel& costs, const ContainerIndex& index, const int startPosition)
+{
+    int position = startPosition; // The next frame the decoder will decode
+
+    for (int frameNumber : frameNumbers)
+    {
+        const double seekCost    = costs.getSeekCost(frameNumber, index);
+        const double forwardCost = (frameNumber >= position) ? costs.getForwardCost(position, frameNumber) : seekCost + 1.0; // Can't decode backwards
+
+        if (runs.empty() || seekCost < forwardCost)
+        {
+            if (runs.empty())
+                firstRunIsSeek = (seekCost < forwardCost);
+            runs.push_back(Run{ frameNumber, frameNumber, 1, std::min(seekCost, forwardCost), 0.0 });
+        }
+        else
+        {
+            Run& run = runs.back();
+            run.lastFrame      = frameNumber;
+            run.numberOfFrames += 1;
+            run.predictedCost  += forwardCost;
+        }
+
+        position = frameNumber + 1;
+    }
+}
+
+bool DecodePlan::startsRun(const int frameNumber) const
+{
+    const int run = findRun(frameNumber);
+
+    if (run < 0)
+        return true; // Not part of the plan, so the only option is to seek
+
+    if (run == 0 && !firstRunIsSeek)
+        return false;
+
+    return runs[run].firstFrame == frameNumber;
+}
+
+void DecodePlan::addActualCost(const int frameNumber, const double cost)
+{
+    const int run = findRun(frameNumber);
+    if (run >= 0)
+        runs[run].actualCost += cost;
+}
+
+double DecodePlan::getPredictedCost() const
+{
+    double cost = 0.0;
+    for (const Run& run : runs)
+        cost += run.predictedCost;
+    return cost;
+}
+
+double DecodePlan::getActualCost() const
+{
+    double cost = 0.0;
+    for (const Run& run : runs)
+        cost += run.actualCost;
+    return cost;
+}
+
+void DecodePlan::print() const
+{
+    std::ios_base::fmtflags flags     { cout.flags() };
+    std::streamsize         precision { cout.precision() };
+    
+    cout << "Decode plan: " << runs.size() << " runs, predicted " << std::fixed << std::setprecision(1) << getPredictedCost() << " ms, actual " << getActualCost() << " ms\n";
+    for (const Run& run : runs)
+        cout << '\t' << (&run == &runs.front() && !firstRunIsSeek ? "read " : "seek ") << run.firstFrame << "-" << run.lastFrame
+             << " (" << run.numberOfFrames << " frames): predicted " << run.predictedCost << " ms, actual " << run.actualCost << " ms\n";
+    
+    cout.flags(flags);
+    cout.precision(precision);
+}
+
+int DecodePlan::findRun(const int frameNumber) const
+{
+    auto next = std::upper_bound(runs.begin(), runs.end(), frameNumber, [](int f, const Run& run) { return f < run.firstFrame; });
+    if (next == runs.begin())
+        return -1;
+
+    const int run = static_cast<int>(next - runs.begin()) - 1;
+    return (frameNumber <= runs[run].lastFrame) ? run : -1;
+}
@@ -0,0 +1,109 @@
+#ifndef DecodePlan_hpp
+#define DecodePlan_hpp
+
+#include <iostream>
+#include <vector>    // for std::vector
+
+#include "ContainerIndex.hpp"
+
+using std::cout;
+using std::vector;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodeCostModel
+        Predicts how long it takes to get to a frame of a particular video, either by seeking to it or
+        by decoding forward to it. The costs depend on the codec, resolution and keyframe interval of
+        each file, so they are measured per file (see `Video::measureDecodeCosts()`).
+
+        A seek starts decoding at the last keyframe at least a few frames (the reader's preroll, see
+        `VideoReader::getSeekPreroll()`) before the target, so the cost of seeking is modelled as a
+        fixed overhead plus the cost of decoding every frame from that keyframe to the target.
+        `cv::VideoCapture` looks for a keyframe 16 frames before the target, while libav seeks
+        straight to the keyframe before it.
+   ----------------------------------------------------------------------------------------------------*/
+
+class DecodeCostModel
+{
+public:
+    DecodeCostModel() {};
+    DecodeCostModel(const int seekPrerollIn) : seekPreroll{ seekPrerollIn } {}
+    DecodeCostModel(const int seekPrerollIn, const double seekOverheadIn, const double frameCostIn) : seekPreroll{ seekPrerollIn }, seekOverhead{ seekOverheadIn }, frameCost{ frameCostIn }, measured{ true } {}
+
+    int    getSeekPreroll()  const { return seekPreroll; }
+    double getSeekOverhead() const { return seekOverhead; }
+    double getFrameCost()    const { return frameCost; }
+    bool   isMeasured()      const { return measured; }
+
+    // The number of frames that are decoded by a seek to `frameNumber`, up to and including `frameNumber` itself
+    // If the keyframes aren't known, the last keyframe is assumed to be half a keyframe interval before where decoding must start
+    int getFramesDecodedBySeek(const int frameNumber, const ContainerIndex& index) const;
+
+    // Predicted cost (in ms) of decoding `frameNumber` by seeking to it
+    double getSeekCost(const int frameNumber, const ContainerIndex& index) const { return seekOverhead + frameCost*getFramesDecodedBySeek(frameNumber, index); }
+
+    // Predicted cost (in ms) of decoding forward from `fromFrameNumber` up to and including `toFrameNumber`
+    double getForwardCost(const int fromFrameNumber, const int toFrameNumber) const { return frameCost*(toFrameNumber - fromFrameNumber + 1); }
+
+private:
+    int    seekPreroll  = 0;   // How many frames before the target the reader starts looking for a keyframe (see VideoReader::getSeekPreroll())
+
+    // Until the costs are measured, a seek is assumed to cost as much as decoding the frames it decodes
+    double seekOverhead = 0.0; // ms
+    double frameCost    = 1.0; // ms
+    bool   measured     = false;
+
+public:
+    const static int defaultKeyframeInterval = 96; // Used when the keyframes are unknown
+};
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodePlan
+        A plan for decoding a sorted list of frames, split into runs. Each run starts with a seek and
+        then decodes forward through the rest of its frames. Because decoding a frame either way leaves
+        the decoder just after that frame, the choice between seeking and decoding forward can be made
+        independently between each pair of neighbouring frames, which makes the plan optimal for the
+        cost model it was made with.
+   ----------------------------------------------------------------------------------------------------*/
+
+class DecodePlan
+{
+public:
+    struct Run
+    {
+        int    firstFrame;          // The frame that is seeked to
+        int    lastFrame;           // The last frame decoded forward to
+        int    numberOfFrames;      // The number of requested frames in the run
+        double predictedCost;       // ms
+        double actualCost;          // ms (0 until the frames have been decoded)
+    };
+
+    DecodePlan() {};
+
+    // Make a plan for decoding `frameNumbers` (sorted and unique), when the decoder will next decode `startPosition`
+    DecodePlan(const vector<int>& frameNumbers, const DecodeCostModel& costs, const ContainerIndex& index, const int startPosition = 0);
+
+    const vector<Run>& getRuns()                             const { return runs; }
+    bool               isEmpty()                             const { return runs.empty(); }
+
+    // Whether the decoder should seek to `frameNumber`, rather than decode forward to it
+    bool               startsRun(const int frameNumber)      const;
+
+    // Record how long `frameNumber` actually took to decode, so it can be compared with the prediction
+    void               addActualCost(const int frameNumber, const double cost);
+
+    double             getPredictedCost()                    const;
+    double             getActualCost()                       const;
+
+    void               print()                               const;
+
+private:
+    // The index in `runs` of the run that `frameNumber` belongs to (-1 if it doesn't belong to any)
+    int                findRun(const int frameNumber)        const;
+
+private:
+    vector<Run> runs {};
+    bool        firstRunIsSeek = true; // False if the first run decodes forward from `startPosition` rather than seeking
+};
+
+#endif /* DecodePlan_hpp */
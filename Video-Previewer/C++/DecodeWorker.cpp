@@ -0,0 +1,94 @@
+#include "DecodeWorker.hpp"
+
+#include <chrono> // for std::chrono::milliseconds
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodeWorker
+   ----------------------------------------------------------------------------------------------------*/
+
+thread_local DecodeWorker::State* DecodeWorker::currentState = nullptr;
+
+DecodeWorker::DecodeWorker() : thread{ &DecodeWorker::runJobs, state }
+{
+}
+
+DecodeWorker::~DecodeWorker()
+{
+    if (!thread.joinable()) // Abandoned
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock { state->mutex };
+        state->stopping = true;
+    }
+    state->changed.notify_all();
+    thread.join();
+}
+
+bool DecodeWorker::run(const std::function<void()>& job, const int timeout)
+{
+    std::unique_lock<std::mutex> lock { state->mutex };
+    state->job           = job;
+    state->hasJob        = true;
+    state->lastHeartbeat = std::chrono::steady_clock::now();
+    state->changed.notify_all();
+
+    // A heartbeat moves the deadline on, which is only seen once the old one has passed
+    while (!state->changed.wait_until(lock, state->lastHeartbeat + std::chrono::milliseconds(timeout), [this]() { return !state->hasJob; }))
+    {
+        if (std::chrono::steady_clock::now() >= state->lastHeartbeat + std::chrono::milliseconds(timeout))
+            return false;
+    }
+
+    return true;
+}
+
+void DecodeWorker::heartbeat()
+{
+    if (currentState == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock { currentState->mutex };
+    currentState->lastHeartbeat = std::chrono::steady_clock::now();
+}
+
+void DecodeWorker::abandon()
+{
+    {
+        std::lock_guard<std::mutex> lock { state->mutex };
+        state->stopping = true;
+    }
+    state->changed.notify_all();
+
+    if (thread.joinable())
+        thread.detach();
+}
+
+void DecodeWorker::runJobs(const std::shared_ptr<State> state)
+{
+    currentState = state.get();
+
+    std::unique_lock<std::mutex> lock { state->mutex };
+
+    while (true)
+    {
+        state->changed.wait(lock, [&]() { return state->hasJob || state->stopping; });
+
+        if (state->hasJob)
+        {
+            std::function<void()> job;
+            job.swap(state->job);
+
+            lock.unlock();
+            job();
+            job = nullptr; // Release whatever the job kept alive (e.g. a stuck decoder) before the owner is told it has finished
+            lock.lock();
+
+            state->hasJob = false;
+            state->changed.notify_all();
+        }
+
+        if (state->stopping && !state->hasJob)
+            return;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef DecodeWorker_hpp
+#define DecodeWorker_hpp
+
+#include <chrono>             // for std::chrono::steady_clock
+#include <condition_variable> // for std::condition_variable
+#include <functional>         // for std::function
+#include <memory>             // for std::shared_ptr
+#include <mutex>              // for std::mutex
+#include <thread>             // for std::thread
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodeWorker
+        A thread that runs one job at a time for its owner, which waits a limited time for each job.
+
+        Damaged files can leave a decoder stuck on one frame for a long time, and a stuck decoder can't
+        be interrupted. `Video::decodeFrame()` decodes each frame on a worker, so that it can give up
+        on a frame that takes too long. Every frame of a video is decoded by the same worker, rather
+        than by a thread started for each frame.
+
+        A job that makes progress, e.g. decoding forward through a long run of frames, can call heartbeat()
+        after each step, so that the time limit applies to each step rather than to the whole job.
+
+        When a job isn't finished in time, the worker is abandoned: it is left to finish the job on
+        its own, and the thread then ends. Everything the job uses has to be kept alive by the job
+        itself. The worker releases the job before its thread ends, and so closes the stuck decoder
+        once the decoder finishes.
+   ----------------------------------------------------------------------------------------------------*/
+
+class DecodeWorker
+{
+public:
+    DecodeWorker();
+    ~DecodeWorker(); // Waits for the thread to finish, unless the worker has been abandoned
+
+    DecodeWorker(const DecodeWorker&)            = delete;
+    DecodeWorker& operator=(const DecodeWorker&) = delete;
+
+    // Run `job` on the worker's thread and wait for it to finish, for up to `timeout` milliseconds after it starts or last calls heartbeat()
+    // Returns false if it hasn't finished by then. The job is then still running, and the worker must be abandoned rather than given another
+    bool run(const std::function<void()>& job, const int timeout);
+
+    // Leave the job that is running to finish on its own, after which the thread ends. The worker can't be used again
+    void abandon();
+
+    // Restart the time limit of the job running on this thread. Does nothing on threads that aren't a worker's
+    static void heartbeat();
+
+private:
+    // Shared with the thread, so that an abandoned thread can outlive the worker
+    struct State
+    {
+        std::mutex                            mutex;
+        std::condition_variable               changed;          // Notified when a job is given to the thread or finished by it, or the thread is told to stop
+        std::function<void()>                 job;              // The job being run. Only ever one at a time
+        std::chrono::steady_clock::time_point lastHeartbeat;    // When the job started, or last called heartbeat()
+        bool                                  hasJob   = false;
+        bool                                  stopping = false;
+    };
+
+    // The state of the worker whose thread this is, for heartbeat(). Null on every other thread
+    static thread_local State* currentState;
+
+    // Run each job given to `state`, until told to stop. Run on `thread`
+    static void runJobs(const std::shared_ptr<State> state);
+
+private:
+    std::shared_ptr<State> state { std::make_shared<State>() };
+    std::thread            thread;
+};
+
+#endif /* DecodeWorker_hpp */
@@ -0,0 +1,315 @@
+#include "FastScan.hpp"
+
+#include <algorithm>  // for std::includes
+#include <atomic>     // for std::atomic
+#include <filesystem> // for std::filesystem::temp_directory_path()
+#include <map>        // for std::map
+#include <mutex>      // for std::mutex
+#include <unistd.h>   // for getpid()
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Functions
+   ----------------------------------------------------------------------------------------------------*/
+
+// Boxes store all integers in big-endian byte order
+static void appendUInt16(vector<uint8_t>& bytes, const uint16_t value) { for (int shift = 8;  shift >= 0; shift -= 8) bytes.push_back(uint8_t(value >> shift)); }
+static void appendUInt32(vector<uint8_t>& bytes, const uint32_t value) { for (int shift = 24; shift >= 0; shift -= 8) bytes.push_back(uint8_t(value >> shift)); }
+static void appendUInt64(vector<uint8_t>& bytes, const uint64_t value) { for (int shift = 56; shift >= 0; shift -= 8) bytes.push_back(uint8_t(value >> shift)); }
+
+static void appendBytes(vector<uint8_t>& bytes, const vector<uint8_t>& moreBytes) { bytes.insert(bytes.end(), moreBytes.begin(), moreBytes.end()); }
+
+static vector<uint8_t> makeBox(const string& type, const vector<uint8_t>& payload)
+{
+    vector<uint8_t> box;
+    appendUInt32(box, static_cast<uint32_t>(payload.size() + 8));
+    box.insert(box.end(), type.begin(), type.end());
+    appendBytes(box, payload);
+    return box;
+}
+
+static void setUInt32(vector<uint8_t>& bytes, const size_t offset, const uint32_t value) { for (int i = 0; i < 4; ++i) bytes[offset + i] = uint8_t(value >> (24 - 8*i)); }
+static void setUInt64(vector<uint8_t>& bytes, const size_t offset, const uint64_t value) { setUInt32(bytes, offset, uint32_t(value >> 32)); setUInt32(bytes, offset + 4, uint32_t(value)); }
+
+static vector<uint8_t> makeFullBox(const string& type, const uint8_t version, const uint32_t flags, const vector<uint8_t>& payload)
+{
+    vector<uint8_t> versionAndFlags;
+    appendUInt32(versionAndFlags, (uint32_t(version) << 24) | flags);
+    appendBytes(versionAndFlags, payload);
+    return makeBox(type, versionAndFlags);
+}
+
+static vector<uint8_t> makeFullBox(const string& type, const uint32_t flags, const vector<uint8_t>& payload) { return makeFullBox(type, 0, flags, payload); }
+
+// Append the creation and modification times, timescale and duration that start both "mvhd" and "mdhd"
+// Returns the version of the box, which is 1 (64 bit times and duration) only if the duration doesn't fit in 32 bits
+static uint8_t appendTimes(vector<uint8_t>& bytes, const uint32_t timescale, const uint64_t duration)
+{
+    if (duration <= UINT32_MAX)
+    {
+        appendUInt32(bytes, 0); appendUInt32(bytes, 0);
+        appendUInt32(bytes, timescale);
+        appendUInt32(bytes, static_cast<uint32_t>(duration));
+        return 0;
+    }
+
+    appendUInt64(bytes, 0); appendUInt64(bytes, 0);
+    appendUInt32(bytes, timescale);
+    appendUInt64(bytes, duration);
+    return 1;
+}
+
+static void appendUnityMatrix(vector<uint8_t>& bytes)
+{
+    for (uint32_t value : { 0x00010000u, 0u, 0u, 0u, 0x00010000u, 0u, 0u, 0u, 0x40000000u })
+        appendUInt32(bytes, value);
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - FastScanner
+   ----------------------------------------------------------------------------------------------------*/
+
+FastScanner::KeyframeFile::KeyframeFile(const vector<int>& frameNumbersIn) : frameNumbers{ frameNumbersIn }
+{
+    static std::atomic<int> fileCount { 0 };
+    path = ( std::filesystem::temp_directory_path() / ("video-previewer-" + std::to_string(getpid()) + "-" + std::to_string(fileCount++) + ".mp4") ).string();
+}
+
+FastScanner::KeyframeFile::~KeyframeFile()
+{
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+FastScanner::FastScanner(const string& videoPath, const ContainerIndex& index, const vector<int>& frameNumbers)
+{
+    file = loadKeyframeFile(videoPath, index, frameNumbers);
+
+    vc.open(file->path, cv::CAP_FFMPEG);
+    if (!vc.isOpened())
+        throw FileException("keyframes could not be decoded\n", videoPath);
+}
+
+FastScanner::~FastScanner()
+{
+    vc.release(); // Before the file can be deleted
+    file.reset();
+}
+
+FastScanner::KeyframeFilePtr FastScanner::loadKeyframeFile(const string& videoPath, const ContainerIndex& index, const vector<int>& frameNumbers)
+{
+    struct CachedFile
+    {
+        std::filesystem::file_time_type modified;
+        uintmax_t                       size;
+        KeyframeFilePtr                 file;
+    };
+
+    const static size_t maxCachedFiles = 4;
+    const static size_t maxExtraFrames = 2; // A cached file is only reused if it holds at most this many times as many keyframes as are needed
+
+    static std::mutex                   cacheMutex;
+    static std::map<string, CachedFile> cache;
+
+    std::error_code                 error;
+    std::filesystem::file_time_type modified { std::filesystem::last_write_time(videoPath, error) };
+    uintmax_t                       size     { std::filesystem::file_size(videoPath, error) };
+
+    {
+        std::lock_guard<std::mutex> lock { cacheMutex };
+
+        auto cached = cache.find(videoPath);
+        if (cached != cache.end() && !error && cached->second.modified == modified && cached->second.size == size)
+        {
+            const vector<int>& cachedFrames = cached->second.file->frameNumbers;
+            if (cachedFrames.size() <= maxExtraFrames * frameNumbers.size() && std::includes(cachedFrames.begin(), cachedFrames.end(), frameNumbers.begin(), frameNumbers.end()))
+                return cached->second.file;
+        }
+    }
+
+    // Written without holding the lock, so copying the keyframes of one video doesn't hold up scanning another
+    // If the file can't be written, it's deleted again as `file` goes out of scope
+    std::shared_ptr<KeyframeFile> file { std::make_shared<KeyframeFile>(frameNumbers) };
+    writeStream(videoPath, index, *file);
+
+    std::lock_guard<std::mutex> lock { cacheMutex };
+
+    // Forget the files of videos that are no longer being scanned, rather than letting them pile up in the temporary directory
+    if (cache.size() >= maxCachedFiles)
+        for (auto cached = cache.begin(); cached != cache.end(); )
+            cached = cached->second.file.use_count() == 1 ? cache.erase(cached) : std::next(cached);
+
+    if (!error)
+        cache[videoPath] = CachedFile{ modified, size, file };
+
+    return file;
+}
+
+bool FastScanner::read(const int frameNumber, Mat& frameOut)
+{
+    const vector<int>& frameNumbers = file->frameNumbers;
+
+    auto target = std::lower_bound(frameNumbers.begin() + position, frameNumbers.end(), frameNumber);
+    if (target == frameNumbers.end() || *target != frameNumber)
+        return false;
+
+    const size_t targetPosition = target - frameNumbers.begin();
+
+    // Keyframes before the target are grabbed but never converted to a `Mat`
+    while (position <= targetPosition)
+    {
+        if (!vc.grab())
+        {
+            position = frameNumbers.size();
+            return false;
+        }
+
+        // Keyframe i in the temporary file has a presentation time of i seconds
+        const size_t decodedPosition = static_cast<size_t>(std::lround(vc.get(cv::CAP_PROP_POS_MSEC) / 1000.0));
+        position = decodedPosition + 1;
+
+        if (decodedPosition == targetPosition)
+            return vc.retrieve(frameOut);
+    }
+
+    return false; // The decoder skipped over the target (e.g. because it is damaged)
+}
+
+void FastScanner::writeStream(const string& videoPath, const ContainerIndex& index, const KeyframeFile& file)
+{
+    const vector<int>& frameNumbers = file.frameNumbers;
+
+    std::ifstream in{ videoPath, std::ios::binary };
+    if (!in)
+        throw FileException("could not open file for reading keyframes\n", videoPath);
+
+    std::ofstream out{ file.path, std::ios::binary };
+    if (!out)
+        throw FileException("could not create temporary file for keyframes\n", file.path);
+
+    const uint32_t timescale   = 1000; // Each keyframe lasts 1 second (see `read()`)
+    const uint32_t sampleCount = static_cast<uint32_t>(frameNumbers.size());
+    const uint64_t duration    = uint64_t(sampleCount) * timescale; // In both the movie's and the track's timescale, which are the same
+
+    // 1. File type
+    vector<uint8_t> ftypPayload { 'i','s','o','m', 0,0,2,0, 'i','s','o','m', 'i','s','o','2', 'm','p','4','1' };
+    vector<uint8_t> ftyp        { makeBox("ftyp", ftypPayload) };
+    out.write(reinterpret_cast<const char*>(ftyp.data()), ftyp.size());
+
+    // 2. Media data: the compressed keyframes, copied without modification. Uses a 64 bit size in case the keyframes exceed 4 GB
+    uint64_t mdatSize = 16;
+    for (int frameNumber : frameNumbers)
+        mdatSize += index.getSampleSize(index.getSampleNumber(frameNumber));
+
+    vector<uint8_t> mdatHeader;
+    appendUInt32(mdatHeader, 1);
+    mdatHeader.insert(mdatHeader.end(), { 'm','d','a','t' });
+    appendUInt64(mdatHeader, mdatSize);
+    out.write(reinterpret_cast<const char*>(mdatHeader.data()), mdatHeader.size());
+
+    vector<uint64_t> chunkOffsets;
+    vector<uint32_t> sampleSizes;
+    vector<char>     sample;
+    uint64_t         offset = ftyp.size() + mdatHeader.size();
+
+    for (int frameNumber : frameNumbers)
+    {
+        const int sampleNumber = index.getSampleNumber(frameNumber);
+        sample.resize(index.getSampleSize(sampleNumber));
+
+        in.seekg(index.getSampleOffset(sampleNumber));
+        if (!in.read(sample.data(), sample.size()))
+            throw FileException("could not read keyframe " + std::to_string(frameNumber) + "\n", videoPath);
+        out.write(sample.data(), sample.size());
+
+        chunkOffsets.push_back(offset);
+        sampleSizes.push_back(static_cast<uint32_t>(sample.size()));
+        offset += sample.size();
+    }
+
+    // 3. Sample table: one sample per chunk, every sample is a keyframe (so no "stss" box is needed)
+    vector<uint8_t> stts, stsc, stsz, co64;
+    appendUInt32(stts, 1);  appendUInt32(stts, sampleCount); appendUInt32(stts, timescale);
+    appendUInt32(stsc, 1);  appendUInt32(stsc, 1);           appendUInt32(stsc, 1);           appendUInt32(stsc, 1);
+    appendUInt32(stsz, 0);  appendUInt32(stsz, sampleCount);
+    for (uint32_t size : sampleSizes)
+        appendUInt32(stsz, size);
+    appendUInt32(co64, sampleCount);
+    for (uint64_t chunkOffset : chunkOffsets)
+        appendUInt64(co64, chunkOffset);
+
+    vector<uint8_t> stbl;
+    appendBytes(stbl, index.getSampleDescriptionBox()); // Codec, dimensions and parameter sets are unchanged from the original video
+    appendBytes(stbl, makeFullBox("stts", 0, stts));
+    appendBytes(stbl, makeFullBox("stsc", 0, stsc));
+    appendBytes(stbl, makeFullBox("stsz", 0, stsz));
+    appendBytes(stbl, makeFullBox("co64", 0, co64));
+
+    // 4. Media information
+    vector<uint8_t> vmhd, dref, hdlr, mdhd;
+    appendUInt64(vmhd, 0); // graphicsmode and opcolor
+
+    appendUInt32(dref, 1);
+    appendBytes(dref, makeFullBox("url ", 1, {})); // Flag 1: the media data is in this file
+
+    appendUInt32(hdlr, 0);
+    hdlr.insert(hdlr.end(), { 'v','i','d','e' });
+    appendUInt32(hdlr, 0); appendUInt32(hdlr, 0); appendUInt32(hdlr, 0);
+    hdlr.push_back(0);     // Empty name
+
+    const uint8_t mdhdVersion = appendTimes(mdhd, timescale, duration);
+    appendUInt16(mdhd, 0x55c4);                   // Language "und"
+    appendUInt16(mdhd, 0);
+
+    vector<uint8_t> minf;
+    appendBytes(minf, makeFullBox("vmhd", 1, vmhd));
+    appendBytes(minf, makeBox("dinf", makeFullBox("dref", 0, dref)));
+    appendBytes(minf, makeBox("stbl", stbl));
+
+    vector<uint8_t> mdia;
+    appendBytes(mdia, makeFullBox("mdhd", mdhdVersion, 0, mdhd));
+    appendBytes(mdia, makeFullBox("hdlr", 0, hdlr));
+    appendBytes(mdia, makeBox("minf", minf));
+
+    // 5. Track and movie headers. The original track header is kept so that any rotation matrix is preserved, but with the duration of the new track
+    // tkhd: header (8), version & flags (4), then creation and modification times and track ID, reserved (4) and duration (4 or 8 bytes each in version 0 or 1)
+    vector<uint8_t> trak { index.getTrackHeaderBox() };
+    if (trak.size() >= 8 + 4 && trak[8] == 1 && trak.size() >= 8 + 36)
+        setUInt64(trak, 8 + 28, duration);
+    else if (trak.size() >= 8 + 4 && trak[8] == 0 && trak.size() >= 8 + 24)
+        setUInt32(trak, 8 + 20, duration <= UINT32_MAX ? static_cast<uint32_t>(duration) : UINT32_MAX); // All 1s if the duration doesn't fit
+    else
+    {
+        vector<uint8_t> tkhd;
+        appendUInt64(tkhd, 0); appendUInt64(tkhd, 0); // Creation and modification times
+        appendUInt32(tkhd, 1);                        // Track ID
+        appendUInt32(tkhd, 0);
+        appendUInt64(tkhd, duration);
+        appendUInt64(tkhd, 0);
+        appendUInt64(tkhd, 0);                        // Layer, alternate group, volume
+        appendUnityMatrix(tkhd);
+        appendUInt64(tkhd, 0);                        // Width and height (the decoder uses those in the sample description)
+        trak = makeFullBox("tkhd", 1, 3, tkhd);       // Version 1, flags: track enabled and in movie
+    }
+    appendBytes(trak, makeBox("mdia", mdia));
+
+    vector<uint8_t> mvhd;
+    const uint8_t mvhdVersion = appendTimes(mvhd, timescale, duration);
+    appendUInt32(mvhd, 0x00010000);                   // Rate 1.0
+    appendUInt16(mvhd, 0x0100);                       // Volume 1.0
+    appendUInt16(mvhd, 0); appendUInt64(mvhd, 0);
+    appendUnityMatrix(mvhd);
+    for (int i = 0; i < 6; ++i)
+        appendUInt32(mvhd, 0);
+    appendUInt32(mvhd, UINT32_MAX);                   // Next track ID: the original track ID is unknown, so don't assume it
+
+    vector<uint8_t> moov;
+    appendBytes(moov, makeFullBox("mvhd", mvhdVersion, 0, mvhd));
+    appendBytes(moov, makeBox("trak", trak));
+
+    vector<uint8_t> moovBox { makeBox("moov", moov) };
+    out.write(reinterpret_cast<const char*>(moovBox.data()), moovBox.size());
+
+    if (!out)
+        throw FileException("could not write temporary file for keyframes\n", file.path);
+}
@@ -0,0 +1,89 @@
+#ifndef FastScan_hpp
+#define FastScan_hpp
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/core/mat.hpp>  // for basic OpenCV structures (Mat, Scalar)
+#include <opencv2/videoio.hpp>
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include "ContainerIndex.hpp"
+
+using cv::Mat;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - FastScanner
+        Decodes a set of keyframes without decoding any of the frames in between them.
+
+        `cv::VideoCapture` doesn't allow us to choose which packets are given to the decoder, and a seek
+        always decodes forward from an earlier keyframe. Instead, the compressed keyframes are copied
+        (without decoding) from the original file into a temporary file containing nothing but those
+        keyframes. Reading that file sequentially decodes exactly one intra frame per keyframe.
+
+        Each keyframe is given a presentation time equal to its position in the temporary file (in
+        seconds), so the frame that was actually decoded can always be identified, even if the decoder
+        drops a damaged frame.
+
+        Writing the temporary file reads every keyframe from the original, so it's shared by every
+        scanner of the same video (e.g. the preview's and the prefetcher's), and kept for as long as
+        they use it. A new scanner reuses it if it holds all of the keyframes asked for and not many
+        more (keyframes in between those asked for are decoded, though never converted). The file is
+        deleted once no scanner is using it and it has been replaced, or the video has changed.
+   ----------------------------------------------------------------------------------------------------*/
+
+class FastScanner
+{
+public:
+    // Copy the keyframes `frameNumbers` (which must all be keyframes, in increasing order) from the video at `videoPath` into a
+    // temporary file (unless one holding them already exists) and open it for decoding
+    // Throws a FileException if the temporary file can't be written or opened
+    FastScanner(const string& videoPath, const ContainerIndex& index, const vector<int>& frameNumbers);
+    ~FastScanner();
+
+    FastScanner(const FastScanner&)            = delete;
+    FastScanner& operator=(const FastScanner&) = delete;
+
+    // Whether FastScanner can decode videos described by `index`
+    static bool canScan(const ContainerIndex& index) { return index.hasSampleLocations() && !index.getSampleDescriptionBox().empty(); }
+
+    // Overwrite `frameOut` with the keyframe `frameNumber`. Keyframes can only be read in increasing order
+    // Returns false if `frameNumber` wasn't one of the keyframes the scanner was made with, or has already been passed
+    bool read(const int frameNumber, Mat& frameOut);
+
+private:
+    // A temporary file holding copies of some of the keyframes of a video, which is deleted when it's destroyed
+    struct KeyframeFile
+    {
+        KeyframeFile(const vector<int>& frameNumbersIn);
+        ~KeyframeFile();
+
+        string      path         {};
+        vector<int> frameNumbers {}; // The frame number (in the original video) of each frame in the file
+    };
+
+    using KeyframeFilePtr = std::shared_ptr<const KeyframeFile>;
+
+    // Return a temporary file holding (at least) the keyframes `frameNumbers` of the video at `videoPath`, writing a new one if no cached file will do
+    // The cache holds a file for each video, and forgets it if the video has been modified since (as ContainerIndex::load() does)
+    static KeyframeFilePtr loadKeyframeFile(const string& videoPath, const ContainerIndex& index, const vector<int>& frameNumbers);
+
+    // Write the keyframes of `file` to its path as an ISO base media file with a single video track
+    static void writeStream(const string& videoPath, const ContainerIndex& index, const KeyframeFile& file);
+
+private:
+    KeyframeFilePtr  file;
+    size_t           position {}; // The index in `file->frameNumbers` of the next frame that will be decoded
+    cv::VideoCapture vc;
+};
+
+#endif /* FastScan_hpp */
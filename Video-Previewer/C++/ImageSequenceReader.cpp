@@ -0,0 +1,227 @@
+#include "ImageSequenceReader.hpp"
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/imgcodecs.hpp> // for cv::imdecode()
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <algorithm>  // for std::sort()
+#include <filesystem> // for std::filesystem::directory_iterator
+#include <mutex>      // for std::mutex
+#include <regex>      // for std::regex
+#include <stdexcept>  // for std::out_of_range
+
+#include <fcntl.h>    // for open()
+#include <sys/mman.h> // for mmap()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for close()
+
+namespace fs = std::filesystem;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ImageSequenceReader
+   ----------------------------------------------------------------------------------------------------*/
+
+// Matches the printf-style conversion for the frame number in a pattern, e.g. "%d" or "%04d"
+static const std::regex framePatternConversion { "%(0?)([0-9]*)d" };
+
+ImageSequenceReader::ImageSequenceReader(const string& sequencePath, const double fpsIn) : files{ getFiles(sequencePath) }, fps{ fpsIn }
+{
+    if (files->empty())
+        return; // isOpened() is false
+
+    Mat firstFrame { loadFrame(files->front()) };
+    if (firstFrame.empty())
+        throw FileException("the first frame of the image sequence could not be read\n", files->front());
+
+    dimensions = firstFrame.size();
+}
+
+bool ImageSequenceReader::isImageSequencePath(const string& filePath)
+{
+    std::error_code error;
+    if (fs::is_directory(filePath, error))
+        return true;
+
+    // A file that exists is a video, even if its name happens to contain e.g. "%d" ("50%done.mp4")
+    return !fs::is_regular_file(filePath, error) && std::regex_search(fs::path(filePath).filename().string(), framePatternConversion);
+}
+
+bool ImageSequenceReader::grab()
+{
+    if (position < 0 || position >= getNumberOfFrames())
+    {
+        decodedFrame = -1;
+        return false;
+    }
+
+    decodedFrame = position++;
+    return true;
+}
+
+bool ImageSequenceReader::retrieve(Mat& frameOut)
+{
+    if (decodedFrame < 0)
+        return false;
+
+    // Frames that were being loaded ahead of time but have been skipped over won't be needed
+    while (!loads.empty() && loads.begin()->first < decodedFrame)
+        loads.erase(loads.begin());
+
+    auto load = loads.find(decodedFrame);
+    if (load != loads.end())
+    {
+        frameOut = load->second.get();
+        loads.erase(load);
+    }
+    else
+        frameOut = loadFrame((*files)[decodedFrame]);
+
+    startLoads();
+    return !frameOut.empty();
+}
+
+void ImageSequenceReader::prepareFrames(const vector<int>& frameNumbers)
+{
+    upcomingFrames    = frameNumbers;
+    nextUpcomingFrame = 0;
+    startLoads();
+}
+
+void ImageSequenceReader::startLoads()
+{
+    while (loads.size() < maxLoadsInFlight && nextUpcomingFrame < upcomingFrames.size())
+    {
+        int frameNumber = upcomingFrames[nextUpcomingFrame++];
+        if (frameNumber <= decodedFrame || frameNumber >= getNumberOfFrames() || loads.count(frameNumber) > 0)
+            continue;
+
+        loads.emplace(frameNumber, std::async(std::launch::async, loadFrame, (*files)[frameNumber]));
+    }
+}
+
+ImageSequenceReader::FileListPtr ImageSequenceReader::getFiles(const string& sequencePath)
+{
+    struct CachedScan
+    {
+        fs::file_time_type directoryModified;
+        FileListPtr        files;
+    };
+
+    static std::mutex                   cacheMutex;
+    static std::map<string, CachedScan> cache;
+
+    std::error_code    error;
+    fs::path           directory { fs::is_directory(sequencePath, error) ? fs::path(sequencePath) : fs::path(sequencePath).parent_path() };
+    fs::file_time_type modified { fs::last_write_time(directory.empty() ? fs::path(".") : directory, error) }; // Changes whenever a file is added, removed or renamed
+
+    std::lock_guard<std::mutex> lock { cacheMutex };
+
+    auto cached = cache.find(sequencePath);
+    if (cached != cache.end() && !error && cached->second.directoryModified == modified)
+        return cached->second.files;
+
+    FileListPtr files { std::make_shared<const FileList>(scanFiles(sequencePath)) };
+    cache[sequencePath] = CachedScan{ modified, files };
+    return files;
+}
+
+ImageSequenceReader::FileList ImageSequenceReader::scanFiles(const string& sequencePath)
+{
+    vector<std::pair<long long, string>> numberedFiles; // Each file with its frame number
+    std::error_code                      error;
+
+    auto addFile = [&numberedFiles](const string& number, const string& filePath)
+    {
+        try
+        {
+            numberedFiles.emplace_back(std::stoll(number), filePath);
+        }
+        catch (const std::out_of_range&)
+        {
+            // Too many digits to be a frame number, so not part of the sequence
+        }
+    };
+
+    if (fs::is_directory(sequencePath, error))
+    {
+        // Every image in the directory, numbered by the last run of digits in its name (so "shot2_0010.png" is frame 10)
+        const static std::regex imageExtension { "\\.(png|jpe?g|exr|tiff?|bmp|webp|jp2|hdr|pnm|pgm|ppm)$", std::regex::icase };
+        const static std::regex lastNumber     { "([0-9]+)[^0-9]*$" };
+
+        for (const fs::directory_entry& entry : fs::directory_iterator(sequencePath, error))
+        {
+            string      name { entry.path().filename().string() };
+            std::smatch number;
+            if (entry.is_regular_file(error) && std::regex_search(name, imageExtension) && std::regex_search(name, number, lastNumber))
+                addFile(number[1], entry.path().string());
+        }
+    }
+    else
+    {
+        // Turn the pattern into a regular expression matching the files' names, capturing the frame number
+        fs::path    pattern   { sequencePath };
+        fs::path    directory { pattern.parent_path().empty() ? fs::path(".") : pattern.parent_path() };
+        string      name      { pattern.filename().string() };
+
+        std::smatch conversion;
+        std::regex_search(name, conversion, framePatternConversion);
+
+        auto escape = [](const string& text) { return std::regex_replace(text, std::regex("[.^$|()\\[\\]{}*+?\\\\]"), "\\$&"); };
+        string digits { conversion[1].length() > 0 && conversion[2].length() > 0 ? "([0-9]{" + conversion[2].str() + ",})" : "([0-9]+)" }; // "%04d" pads to at least 4 digits
+        std::regex filePattern { escape(conversion.prefix().str()) + digits + escape(conversion.suffix().str()) };
+
+        for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+        {
+            string      fileName { entry.path().filename().string() };
+            std::smatch number;
+            if (entry.is_regular_file(error) && std::regex_match(fileName, number, filePattern))
+                addFile(number[1], entry.path().string());
+        }
+    }
+
+    std::sort(numberedFiles.begin(), numberedFiles.end());
+
+    FileList files;
+    files.reserve(numberedFiles.size());
+    for (auto& numberedFile : numberedFiles)
+        files.push_back(std::move(numberedFile.second));
+
+    return files;
+}
+
+Mat ImageSequenceReader::loadFrame(const string& filePath)
+{
+    int file = open(filePath.c_str(), O_RDONLY);
+    if (file < 0)
+        return Mat{};
+
+    struct stat fileInfo;
+    if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0)
+    {
+        close(file);
+        return Mat{};
+    }
+
+    void* data = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // The mapping stays valid after the file is closed
+
+    if (data == MAP_FAILED)
+        return Mat{};
+
+    // cv::imdecode() writes the image to new memory, so the mapping can be removed straight afterwards
+    Mat frame { cv::imdecode(Mat(1, static_cast<int>(fileInfo.st_size), CV_8U, data), cv::IMREAD_COLOR) };
+    munmap(data, fileInfo.st_size);
+
+    return frame;
+}
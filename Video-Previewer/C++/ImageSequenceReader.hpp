@@ -0,0 +1,75 @@
+#ifndef ImageSequenceReader_hpp
+#define ImageSequenceReader_hpp
+
+#include <future> // for std::future
+#include <map>    // for std::map
+
+#include "VideoReader.hpp"
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ImageSequenceReader
+        A `VideoReader` for a numbered sequence of image files (PNG, JPEG, EXR, ...), given either as a
+        directory containing nothing but the sequence, or as a printf-style pattern such as
+        "frames/shot_%04d.exr". The files are ordered by their frame number.
+
+        Seeking and grabbing don't touch the files at all; a file is only read when its frame is
+        retrieved, so only the frames that are actually sampled are ever loaded. Once told which frames
+        are coming (see `prepareFrames()`), the next few are loaded in parallel ahead of time. Each file
+        is read through a memory map and decoded straight from it.
+
+        The list of files is cached for each sequence, so opening further readers for the same sequence
+        (e.g. one per extraction thread) doesn't scan the directory again unless it has changed.
+   ----------------------------------------------------------------------------------------------------*/
+
+class ImageSequenceReader : public VideoReader
+{
+public:
+    // Throws a FileException if the sequence has no frames, or its first frame can't be read
+    ImageSequenceReader(const string& sequencePath, const double fpsIn);
+    ~ImageSequenceReader() { loads.clear(); } // Wait for any frames still being loaded
+
+    // Whether `filePath` is a directory, or a printf-style pattern (containing e.g. "%d" or "%04d")
+    static bool isImageSequencePath(const string& filePath);
+
+    bool     isOpened()          const override { return !files->empty(); }
+    int      getPosition()       const override { return position; }
+    int      getNumberOfFrames() const override { return static_cast<int>(files->size()); }
+    int      getCodec()          const override { return 0; }
+    double   getFPS()            const override { return fps; }
+    cv::Size getDimensions()     const override { return dimensions; }
+
+    void     seek(const int frameNumber) override { position = frameNumber; decodedFrame = -1; }
+    bool     grab()                      override;
+    bool     retrieve(Mat& frameOut)     override;
+
+    bool     isContainerFile()   const override { return false; }
+    void     prepareFrames(const vector<int>& frameNumbers) override;
+
+private:
+    using FileList    = vector<string>;
+    using FileListPtr = std::shared_ptr<const FileList>;
+
+    // The files in the sequence at `sequencePath`, in order. Scanned once, then cached until the directory changes
+    static FileListPtr getFiles(const string& sequencePath);
+    static FileList    scanFiles(const string& sequencePath);
+
+    // Read `filePath` through a memory map and decode it as 8-bit BGR. Returns an empty `Mat` if the file can't be read
+    static Mat         loadFrame(const string& filePath);
+
+    // Start loading the upcoming frames, until `maxLoadsInFlight` are being loaded
+    void               startLoads();
+
+private:
+    FileListPtr                     files;
+    double                          fps;
+    cv::Size                        dimensions;
+    int                             position          = 0;
+    int                             decodedFrame      = -1; // The frame "decoded" by the last call to grab() (-1 if there isn't one)
+    vector<int>                     upcomingFrames;         // From prepareFrames()
+    size_t                          nextUpcomingFrame = 0;  // The index in `upcomingFrames` of the next frame to start loading
+    std::map<int, std::future<Mat>> loads;                  // Frames being loaded ahead of time, keyed by frame number
+
+    const static size_t             maxLoadsInFlight  = 4;
+};
+
+#endif /* ImageSequenceReader_hpp */
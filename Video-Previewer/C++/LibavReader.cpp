@@ -0,0 +1,285 @@
+#include "LibavReader.hpp"
+
+#ifdef VIDEO_PREVIEWER_LIBAV
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <cmath>  // for std::llround, std::isfinite
+#include <cstdio> // for SEEK_SET, SEEK_CUR and SEEK_END
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - LibavReader
+   ----------------------------------------------------------------------------------------------------*/
+
+LibavReader::LibavReader(const string& filePath, const double defaultFPS)
+{
+    // libavformat reads the file through `file`, so that the parts of it holding upcoming frames can be read ahead of time (see readAhead())
+    file = std::make_shared<ReadAheadFile>(filePath);
+
+    uint8_t* ioBuffer = static_cast<uint8_t*>(av_malloc(ioBufferSize));
+    io     = avio_alloc_context(ioBuffer, ioBufferSize, 0, this, &readFromFile, nullptr, &seekInFile);
+    format = avformat_alloc_context();
+    if (!io || !format)
+    {
+        if (!io)
+            av_free(ioBuffer);
+        close();
+        throw FileException("libavformat could not be set up to read the file\n", filePath);
+    }
+    format->pb = io;
+
+    if (avformat_open_input(&format, filePath.c_str(), nullptr, nullptr) < 0) // Frees `format` if it fails
+    {
+        close();
+        throw FileException("file could not be opened by libavformat\n", filePath);
+    }
+
+    if (avformat_find_stream_info(format, nullptr) < 0)
+    {
+        close();
+        throw FileException("libavformat could not read the streams in the file\n", filePath);
+    }
+
+    streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    const AVCodec* decoder = streamIndex >= 0 ? avcodec_find_decoder(format->streams[streamIndex]->codecpar->codec_id) : nullptr;
+    if (!decoder)
+    {
+        close();
+        throw FileException("file has no video track that libavcodec can decode\n", filePath);
+    }
+
+    AVStream* stream = format->streams[streamIndex];
+
+    threads = ThreadBudget::getInstance().allocateDecoder("\"" + filePath + "\" (libav)");
+    if (!openCodec(threads->getThreads()))
+    {
+        close();
+        throw FileException("libavcodec could not open a decoder for the video track\n", filePath);
+    }
+
+    frame  = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!frame || !packet)
+    {
+        close();
+        throw FileException("libavcodec could not allocate a frame or packet to decode with\n", filePath);
+    }
+
+    AVRational frameRate { stream->avg_frame_rate.num != 0 ? stream->avg_frame_rate : stream->r_frame_rate };
+    secondsPerTick = av_q2d(stream->time_base);
+    startTime      = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    fps            = av_q2d(frameRate);
+    if (!std::isfinite(fps) || fps <= 0) // Neither rate is recorded (0/0)
+        fps = defaultFPS;
+    codecTag       = static_cast<int>(stream->codecpar->codec_tag);
+    dimensions     = cv::Size(stream->codecpar->width, stream->codecpar->height);
+
+    if (stream->nb_frames > 0)
+        numberOfFrames = static_cast<int>(stream->nb_frames);
+    else if (stream->duration != AV_NOPTS_VALUE)
+        numberOfFrames = static_cast<int>(std::llround(stream->duration * secondsPerTick * fps));
+    else
+        numberOfFrames = static_cast<int>(std::llround(static_cast<double>(format->duration) / AV_TIME_BASE * fps));
+
+    // Demuxers that read an index from the container (e.g. the sample tables of an ISO base media file) give every packet up front
+    // The index only records decode time stamps, so the presentation time stamps are unknown
+    int NEntries = avformat_index_get_entries_count(stream);
+    packets.reserve(NEntries);
+    for (int i = 0; i < NEntries; ++i)
+    {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        packets.push_back(PacketInfo{ PacketInfo::unknownTimestamp,
+                                      entry->timestamp,
+                                      (entry->timestamp - startTime) * secondsPerTick,
+                                      entry->pos,
+                                      static_cast<uint32_t>(entry->size),
+                                      (entry->flags & AVINDEX_KEYFRAME) != 0 });
+    }
+}
+
+void LibavReader::seek(const int frameNumber)
+{
+    int64_t timestamp = startTime + std::llround(frameNumber / fps / secondsPerTick);
+
+    // Seeks to the last keyframe at or before `timestamp`
+    av_seek_frame(format, streamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
+    // The decoder has to be flushed anyway, so this is when it can change to a new share of the thread budget
+    // If a new decoder can't be opened the old one is kept, so it is flushed whatever happens
+    if (threads->getThreads() == codecThreads || !openCodec(threads->getThreads()))
+        avcodec_flush_buffers(codec);
+
+    endOfFile       = false;
+    hasFrame        = false;
+    hasPendingFrame = false;
+    position        = frameNumber;
+
+    // Decode forward until the decoder reaches `frameNumber`, keeping that frame for the next call to grab()
+    while (decodeNextFrame())
+    {
+        if (getDecodedFrameNumber() >= frameNumber)
+        {
+            hasPendingFrame = true;
+            return;
+        }
+    }
+}
+
+bool LibavReader::grab()
+{
+    if (hasPendingFrame)
+        hasPendingFrame = false;
+    else if (!decodeNextFrame())
+        return hasFrame = false;
+
+    position = getDecodedFrameNumber() + 1;
+    return hasFrame = true;
+}
+
+bool LibavReader::retrieve(Mat& frameOut)
+{
+    return hasFrame && convertFrame(frameOut, cv::Size(frame->width, frame->height), AV_PIX_FMT_BGR24, SWS_BILINEAR, converter);
+}
+
+bool LibavReader::retrieveThumbnail(Mat& thumbnailOut, const cv::Size thumbnailSize)
+{
+    // The frame is shrunk while it's still in the decoder's own format (normally YUV 4:2:0, so half the size of BGR), and converted to RGB at the same time
+    return hasFrame && convertFrame(thumbnailOut, thumbnailSize, AV_PIX_FMT_RGB24, SWS_AREA, thumbnailConverter);
+}
+
+bool LibavReader::convertFrame(Mat& frameOut, const cv::Size size, const int pixelFormat, const int scalingFlags, SwsContext*& context)
+{
+    context = sws_getCachedContext(context,
+                                   frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                   size.width,   size.height,   static_cast<AVPixelFormat>(pixelFormat),
+                                   scalingFlags, nullptr, nullptr, nullptr);
+    if (!context)
+        return false;
+
+    frameOut.create(size, CV_8UC3);
+
+    uint8_t* destination[1]       { frameOut.data };
+    int      destinationStride[1] { static_cast<int>(frameOut.step[0]) };
+    sws_scale(context, frame->data, frame->linesize, 0, frame->height, destination, destinationStride);
+
+    return true;
+}
+
+bool LibavReader::openCodec(const int NThreads)
+{
+    const AVCodecParameters* parameters = format->streams[streamIndex]->codecpar;
+    const AVCodec*           decoder    = avcodec_find_decoder(parameters->codec_id);
+
+    AVCodecContext* newCodec = avcodec_alloc_context3(decoder);
+    if (!newCodec)
+        return false;
+
+    if (avcodec_parameters_to_context(newCodec, parameters) < 0)
+    {
+        avcodec_free_context(&newCodec);
+        return false;
+    }
+
+    newCodec->thread_count = NThreads;
+    newCodec->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(newCodec, decoder, nullptr) < 0)
+    {
+        avcodec_free_context(&newCodec);
+        return false;
+    }
+
+    avcodec_free_context(&codec);
+    codec        = newCodec;
+    codecThreads = NThreads;
+    return true;
+}
+
+bool LibavReader::decodeNextFrame()
+{
+    while (true)
+    {
+        int result = avcodec_receive_frame(codec, frame);
+        if (result == 0)
+            return true;
+
+        if (result != AVERROR(EAGAIN) || endOfFile) // The end of the video, or an error that the decoder can't recover from
+            return false;
+
+        // The decoder needs another packet
+        if (av_read_frame(format, packet) < 0)
+        {
+            endOfFile = true;
+            avcodec_send_packet(codec, nullptr); // Drain the frames that the decoder is still holding on to
+            continue;
+        }
+
+        if (packet->stream_index == streamIndex)
+            avcodec_send_packet(codec, packet);
+
+        av_packet_unref(packet);
+    }
+}
+
+int LibavReader::readFromFile(void* opaque, uint8_t* buffer, int size)
+{
+    LibavReader* reader = static_cast<LibavReader*>(opaque);
+
+    int64_t bytes = reader->file->read(reader->ioPosition, buffer, static_cast<size_t>(size));
+    if (bytes < 0)
+        return AVERROR(EIO);
+    if (bytes == 0)
+        return AVERROR_EOF;
+
+    reader->ioPosition += static_cast<uint64_t>(bytes);
+    return static_cast<int>(bytes);
+}
+
+int64_t LibavReader::seekInFile(void* opaque, int64_t offset, int whence)
+{
+    LibavReader*  reader   = static_cast<LibavReader*>(opaque);
+    const int64_t fileSize = static_cast<int64_t>(reader->file->getSize());
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE: return fileSize;
+        case SEEK_SET:    break;
+        case SEEK_CUR:    offset += static_cast<int64_t>(reader->ioPosition); break;
+        case SEEK_END:    offset += fileSize; break;
+        default:          return AVERROR(EINVAL);
+    }
+
+    if (offset < 0)
+        return AVERROR(EINVAL);
+
+    reader->ioPosition = static_cast<uint64_t>(offset);
+    return offset;
+}
+
+int LibavReader::getDecodedFrameNumber() const
+{
+    if (frame->best_effort_timestamp == AV_NOPTS_VALUE)
+        return position;
+
+    return static_cast<int>(std::llround((frame->best_effort_timestamp - startTime) * secondsPerTick * fps));
+}
+
+void LibavReader::close()
+{
+    sws_freeContext(converter);
+    sws_freeContext(thumbnailConverter);
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&codec);
+    avformat_close_input(&format);
+    if (io)
+        av_freep(&io->buffer); // The buffer may have been replaced by libavformat, so is freed through `io` rather than by the pointer allocated
+    avio_context_free(&io);
+    converter          = nullptr;
+    thumbnailConverter = nullptr;
+}
+
+#endif /* VIDEO_PREVIEWER_LIBAV */
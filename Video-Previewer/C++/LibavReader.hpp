@@ -0,0 +1,108 @@
+#ifndef LibavReader_hpp
+#define LibavReader_hpp
+
+#ifdef VIDEO_PREVIEWER_LIBAV
+
+#include "ThreadBudget.hpp"
+#include "VideoReader.hpp"
+
+struct AVFormatContext;
+struct AVIOContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - LibavReader
+        A `VideoReader` built directly on libavformat and libavcodec, rather than going through
+        cv::VideoCapture (which uses the same libraries, but hides most of what they know).
+
+        This exposes the demuxer's packet index (`getPackets()`), and lets libavcodec decode on as many
+        threads as the reader's share of the `ThreadBudget`. Frame numbers are worked out from each
+        frame's time stamp, so they stay correct after a seek even if the decoder drops or reorders
+        frames. The demuxer reads the file through a `ReadAheadFile`, so the packets of upcoming
+        frames can be read from the file before they are needed.
+
+        Only built when VIDEO_PREVIEWER_LIBAV is defined, in which case the target must also be linked
+        against libavformat, libavcodec, libavutil and libswscale.
+   ----------------------------------------------------------------------------------------------------*/
+
+class LibavReader : public VideoReader
+{
+public:
+    // Throws a FileException if the file can't be opened, or has no video track that libavcodec can decode
+    // `defaultFPS` is the frame rate of a video track that doesn't record one
+    LibavReader(const string& filePath, const double defaultFPS);
+    ~LibavReader() { close(); }
+
+    LibavReader(const LibavReader&)            = delete;
+    LibavReader& operator=(const LibavReader&) = delete;
+
+    bool     isOpened()          const override { return codec != nullptr; }
+    int      getPosition()       const override { return position; }
+    int      getNumberOfFrames() const override { return numberOfFrames; }
+    int      getCodec()          const override { return codecTag; }
+    double   getFPS()            const override { return fps; }
+    cv::Size getDimensions()     const override { return dimensions; }
+
+    void     seek(const int frameNumber) override;
+    bool     grab()                      override;
+    bool     retrieve(Mat& frameOut)     override;
+    bool     retrieveThumbnail(Mat& thumbnailOut, const cv::Size thumbnailSize) override;
+
+    vector<PacketInfo> getPackets() const override { return packets; }
+
+    void     readAhead(const vector<ByteRange>& ranges) override { file->readAhead(ranges); }
+    void     releaseThreads()                           override { threads->release(); }
+
+private:
+    // (Re)open `codec` to decode on `NThreads` threads. Returns false (leaving `codec` as it was) if libavcodec can't open a decoder
+    bool     openCodec(const int NThreads);
+
+    // Overwrite `frame` with the next frame out of the decoder, reading packets from the file as needed. Returns false at the end of the video
+    bool     decodeNextFrame();
+
+    // Scale `frame` to `size` and convert it to `pixelFormat` (an AVPixelFormat) in a single pass, using (and if need be remaking) `context`
+    bool     convertFrame(Mat& frameOut, const cv::Size size, const int pixelFormat, const int scalingFlags, SwsContext*& context);
+
+    // The frame number of the frame in `frame`, worked out from its time stamp
+    int      getDecodedFrameNumber() const;
+
+    void     close();
+
+    // Read and seek callbacks for `io`, which reads from `file`. `opaque` is the reader
+    static int     readFromFile(void* opaque, uint8_t* buffer, int size);
+    static int64_t seekInFile(void* opaque, int64_t offset, int whence);
+
+    const static int ioBufferSize = 64*1024; // The size of the reads libavformat makes through `io` (`file` reads much larger blocks)
+
+private:
+    ReadAheadFilePtr    file;                            // The file, read through a cache that upcoming packets are read into ahead of time
+    AVIOContext*        io                 = nullptr;    // Reads `file` for `format`
+    uint64_t            ioPosition         = 0;          // Where in `file` the next read through `io` is from
+    AVFormatContext*    format             = nullptr;
+    AVCodecContext*     codec              = nullptr;
+    AVFrame*            frame              = nullptr;    // The last frame out of the decoder
+    AVPacket*           packet             = nullptr;
+    SwsContext*         converter          = nullptr;    // Converts `frame` to BGR, remade only when the frame's size or pixel format changes
+    SwsContext*         thumbnailConverter = nullptr;    // Shrinks `frame` and converts it to RGB, remade only when the thumbnail size changes too
+    int                 streamIndex        = -1;
+    double              secondsPerTick     = 0.0;        // The time base of the video stream
+    int64_t             startTime          = 0;          // The time stamp of the first frame, in the stream's time base
+    double              fps                = 0.0;
+    int                 numberOfFrames     = 0;
+    int                 codecTag           = 0;
+    cv::Size            dimensions;
+    int                 position           = 0;          // See getPosition()
+    bool                hasFrame           = false;      // Whether `frame` holds a frame that can be retrieved
+    bool                hasPendingFrame    = false;      // Whether `frame` was decoded by seek(), and should be returned by the next grab() without decoding
+    bool                endOfFile          = false;      // Whether every packet has been read, so the decoder is being drained
+    vector<PacketInfo>  packets;
+    ThreadAllocationPtr threads;                         // This reader's share of the thread budget
+    int                 codecThreads       = 0;          // The number of threads `codec` was opened with
+};
+
+#endif /* VIDEO_PREVIEWER_LIBAV */
+
+#endif /* LibavReader_hpp */
@@ -0,0 +1,155 @@
+#include "Prefetch.hpp"
+
+#include <chrono>   // for std::chrono::steady_clock
+#include <iostream> // for std::cout
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - FramePrefetcher
+   ----------------------------------------------------------------------------------------------------*/
+
+FramePrefetcher::FramePrefetcher(const Video& decoderIn)
+    : decoder{ decoderIn }, numberOfFrames{ decoderIn.getNumberOfFrames() }, thread{ &FramePrefetcher::run, this }
+{
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+        token.cancel();
+    }
+    requestChanged.notify_all();
+
+    thread.join();
+}
+
+void FramePrefetcher::prefetchAround(const int frameNumber, const int window, const cv::Size thumbnailSize)
+{
+    centre        = frameNumber;
+    currentWindow = window;
+
+    int first = std::max(frameNumber - window, 0);
+    int last  = std::min(frameNumber + window, numberOfFrames - 1);
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+
+        // The thread finishes the frame it's on, then moves on to this request
+        token.cancel();
+        token = CancellationToken{};
+        ++generation;
+
+        // Thumbnails of a different size can't be reused, and frames far from the window are unlikely to be needed again
+        if (thumbnailSize != currentSize)
+            cache.clear();
+
+        for (auto it = cache.begin(); it != cache.end(); )
+        {
+            if (std::abs(it->first - frameNumber) > 2*window)
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+
+        vector<int> forward;  // The selected frame and those after it
+        vector<int> backward; // The frames before the selected frame
+
+        for (int i = std::max(frameNumber, first); i <= last; ++i)
+            if (cache.count(i) == 0)
+                forward.push_back(i);
+
+        for (int i = first; i < std::min(frameNumber, last + 1); ++i)
+            if (cache.count(i) == 0)
+                backward.push_back(i);
+
+        request = Request{ { forward, backward }, thumbnailSize, frameNumber, generation };
+    }
+    requestChanged.notify_all();
+
+    currentSize = thumbnailSize;
+}
+
+std::optional<Frame> FramePrefetcher::getCachedFrame(const int frameNumber)
+{
+    std::lock_guard<std::mutex> lock { mutex };
+
+    auto it = cache.find(frameNumber);
+    if (it == cache.end())
+        return {};
+
+    return it->second;
+}
+
+std::optional<Frame> FramePrefetcher::getFrame(const int frameNumber)
+{
+    if (centre < 0 || frameNumber < 0 || frameNumber >= numberOfFrames)
+        return {};
+
+    if (auto frame = getCachedFrame(frameNumber))
+        return frame;
+
+    if (std::abs(frameNumber - centre) > currentWindow)
+        prefetchAround(frameNumber, currentWindow, currentSize);
+
+    return {};
+}
+
+void FramePrefetcher::run()
+{
+    decoder.setDecodeEngine(DecodeEngine::eHybrid);
+
+    std::unique_lock<std::mutex> lock { mutex };
+
+    while (true)
+    {
+        requestChanged.wait(lock, [this]() { return stopping || request; });
+        if (stopping)
+            return;
+
+        Request           nextRequest { std::move(request.value()) };
+        CancellationToken runToken    { token };
+        request.reset();
+
+        lock.unlock();
+        decodeRequest(nextRequest, runToken);
+        lock.lock();
+    }
+}
+
+void FramePrefetcher::decodeRequest(const Request& runRequest, const CancellationToken runToken)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    int  decoded   = 0;
+
+    decoder.setCancellationToken(runToken);
+
+    Mat thumbnail;
+    for (const vector<int>& frameNumbers : runRequest.runs)
+    {
+        decoder.prepareFrames(frameNumbers);
+
+        for (int frameNumber : frameNumbers)
+        {
+            if (runToken.isCancelled())
+                break;
+
+            // A frame that takes too long to decode is given up on, along with the rest of the run (which the new decoder hasn't been prepared for)
+            if (!decoder.decodeFrame(frameNumber, thumbnail, runRequest.thumbnailSize) || runToken.isCancelled() || thumbnail.empty())
+                break;
+
+            {
+                // A frame finished after a new request was made may be of the wrong size, so is only kept if no new request has been made
+                std::lock_guard<std::mutex> lock { mutex };
+                if (generation == runRequest.generation)
+                    cache.insert_or_assign(frameNumber, Frame(thumbnail, frameNumber, decoder.getFrameSeconds(frameNumber)));
+            }
+            thumbnail.release(); // Don't write into the Mat that was just given to the frame
+            ++decoded;
+        }
+    }
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Prefetched " << decoded << " frames around frame " << runRequest.centre << " in " << milliseconds << " ms\n";
+}
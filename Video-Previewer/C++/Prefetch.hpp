@@ -0,0 +1,81 @@
+#ifndef Prefetch_hpp
+#define Prefetch_hpp
+
+#include <condition_variable> // for std::condition_variable
+#include <map>                // for std::map
+#include <mutex>              // for std::mutex
+#include <optional>           // for std::optional
+#include <thread>             // for std::thread
+
+#include "Preview.hpp"
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - FramePrefetcher
+        Decodes the frames around a selected frame in the background, so that stepping forwards or
+        backwards from it can be answered straight from memory.
+
+        The prefetcher has its own decoder and a single thread, which lasts as long as the prefetcher.
+        It decodes forward from the selected frame first (the most common direction to step in), and
+        then the frames before it. DecodeEngine::eHybrid is used, so the decoder carries on from
+        wherever it already is whenever that is cheaper than seeking, and moving the selection forward
+        usually only costs the frames that are new to the window.
+
+        Nothing called from the GUI thread waits for the decoder: a new window cancels the one being
+        decoded (which stops after the frame it's on) and is picked up by the thread once it has.
+   ----------------------------------------------------------------------------------------------------*/
+
+class FramePrefetcher
+{
+public:
+    // Decodes with `decoderIn`, which should be a decoder of its own (see Video::reopen())
+    FramePrefetcher(const Video& decoderIn);
+    ~FramePrefetcher(); // Waits for the frame being decoded to finish
+
+    FramePrefetcher(const FramePrefetcher&)            = delete;
+    FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+    // Start decoding the `window` frames either side of `frameNumber` (at `thumbnailSize`), replacing any earlier request. Returns straight away
+    // Frames that have already been decoded are kept, as long as they are still near enough to `frameNumber`
+    void                 prefetchAround(const int frameNumber, const int window, const cv::Size thumbnailSize);
+
+    // Return `frameNumber` if it has already been decoded
+    std::optional<Frame> getCachedFrame(const int frameNumber);
+
+    // Return `frameNumber` if it has already been decoded. Otherwise returns an empty optional without waiting, first moving the window to be
+    // centred on the frame if it isn't part of it, so that it is decoded soon. Also empty if the frame is past the end of the video, or
+    // prefetchAround() has never been called
+    std::optional<Frame> getFrame(const int frameNumber);
+
+private:
+    // The frames a call to prefetchAround() asked for
+    struct Request
+    {
+        vector<vector<int>> runs;          // Decoded in turn, each in increasing order
+        cv::Size            thumbnailSize;
+        int                 centre;
+        unsigned long       generation;
+    };
+
+    // Decode each request in turn, until the prefetcher is destroyed. Run on `thread`
+    void                 run();
+
+    // Decode the frames of `request`, adding each to `cache` as soon as it's decoded, until `runToken` is cancelled
+    void                 decodeRequest(const Request& request, const CancellationToken runToken);
+
+private:
+    Video                   decoder;                // Only used by `thread`
+    const int               numberOfFrames;
+    std::mutex              mutex;
+    std::condition_variable requestChanged;         // Notified when there's a new request, or the prefetcher is being destroyed
+    std::map<int, Frame>    cache;                  // The frames decoded so far. Guarded by `mutex`, as are the next four
+    std::optional<Request>  request;                // The request waiting to be decoded (if any)
+    unsigned long           generation    = 0;      // Incremented by every request, so that frames decoded for an earlier one are recognised
+    CancellationToken       token;                  // Cancels the request being decoded
+    bool                    stopping      = false;
+    int                     centre        = -1;     // The frame the current window is centred on. Only used on the caller's thread, as are the next two
+    int                     currentWindow = 0;
+    cv::Size                currentSize;
+    std::thread             thread;                 // Started last, once everything it uses has been initialised
+};
+
+#endif /* Prefetch_hpp */
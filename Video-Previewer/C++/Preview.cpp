@@ -1,4 +1,13 @@
 #include "Preview.hpp"
+#include "Prefetch.hpp"
+#include "ThreadBudget.hpp"
+#include "ThumbnailKernel.hpp"
+
+#include <chrono>             // for std::chrono::steady_clock
+#include <cmath>              // for std::lround()
+#include <condition_variable> // for std::condition_variable
+#include <future>             // for std::async
+#include <thread>             // for std::thread
 
 /*----------------------------------------------------------------------------------------------------
     MARK: - Functions
@@ -23,26 +32,731 @@ string secondsToTimeStamp(const double seconds)
     return H + ':' + M + ':' + S + ':' + R;
 }
 
-double frameNumberToSeconds(const int frameNumber, const int fps)
+string decodeEngineToString(const DecodeEngine engine)
+{
+    switch (engine)
+    {
+        case DecodeEngine::eSeek:       return "seek";
+        case DecodeEngine::eSequential: return "sequential";
+        case DecodeEngine::eHybrid:     return "hybrid";
+        case DecodeEngine::eFastScan:   return "fast scan";
+    }
+    return "";
+}
+
+double frameNumberToSeconds(const int frameNumber, const double fps)
 {
     return static_cast<double>(frameNumber) / fps;
 }
 
+// The `i`th element of the base 2 van der Corput sequence: 0, 1/2, 1/4, 3/4, 1/8, 5/8, 3/8, 7/8, 1/16, ...
+// The first N elements are a prefix of the first M for any M > N, so the points sampled for N frames are also sampled for any larger
+// number of frames. They are spread across [0,1) with no gap more than twice as big as any other
+static double vanDerCorput(unsigned int i)
+{
+    double x    = 0.0;
+    double base = 0.5;
+    for (; i > 0; i >>= 1, base /= 2)
+        if (i & 1)
+            x += base;
+    return x;
+}
+
+// Decode `frameNumbers` (in increasing order) from `video` using `engine`, returning the frames in the same order
+// Each frame is shrunk to `thumbnailSize` (and its pyramid built) as soon as it is decoded, so at most one full size frame is held at a time
+// Stops early (returning only the frames decoded so far) if `update` is cancelled or its deadline passes
+// A frame that takes longer than the video's decode timeout is replaced by the next keyframe (or, if the keyframes are unknown, the frame
+// halfway to the next frame), as long as that comes before the next frame (otherwise it is skipped, and its `Frame` left empty). Either way
+// it is logged on std::cerr
+static vector<Frame> decodeFrames(Video& video, const DecodeEngine engine, const vector<int>& frameNumbers, const cv::Size thumbnailSize, PreviewUpdate& update)
+{
+    vector<Frame> framesOut;
+    framesOut.reserve(frameNumbers.size());
+    
+    Mat thumbnail;
+    
+    video.setDecodeEngine(engine);
+    video.setCancellationToken(update.getCancellationToken());
+    video.prepareFrames(frameNumbers);
+    for (size_t i = 0; i < frameNumbers.size(); ++i)
+    {
+        if (update.isCancelled())
+            break;
+        
+        int frameNumber       = frameNumbers[i];
+        int sourceFrameNumber = frameNumber;
+        
+        if (!video.decodeFrame(frameNumber, thumbnail, thumbnailSize))
+        {
+            int nextFrameNumber = (i + 1 < frameNumbers.size()) ? frameNumbers[i + 1] : video.getNumberOfFrames();
+            sourceFrameNumber   = video.getNextKeyframe(frameNumber);
+            
+            // If the keyframes are unknown, the frame halfway to the next one is tried instead. Reaching it decodes from whichever keyframe is
+            // before it, which is more likely to be past the damage than the frame that got stuck
+            if (sourceFrameNumber < 0 && !video.hasKeyframeIndex() && video.getPackets().empty())
+                sourceFrameNumber = frameNumber + (nextFrameNumber - frameNumber)/2;
+            if (sourceFrameNumber <= frameNumber)
+                sourceFrameNumber = -1;
+            
+            if (sourceFrameNumber < 0 || sourceFrameNumber >= nextFrameNumber || !video.decodeFrame(sourceFrameNumber, thumbnail, thumbnailSize) || thumbnail.empty())
+            {
+                sourceFrameNumber = -1;
+                thumbnail.release();
+            }
+            
+            std::cerr << "\tFrame " << frameNumber + 1 << " took too long to decode; ";
+            if (sourceFrameNumber >= 0)
+                std::cerr << "showing frame " << sourceFrameNumber + 1 << " instead\n";
+            else
+                std::cerr << "skipping it\n";
+            
+            // The video has a new decoder, which hasn't been prepared for the rest of the frames
+            video.prepareFrames(vector<int>(frameNumbers.begin() + i + 1, frameNumbers.end()));
+        }
+        
+        if (update.isCancelled())
+            break;
+        
+        framesOut.emplace_back(thumbnail, frameNumber, video.getFrameSeconds(sourceFrameNumber >= 0 ? sourceFrameNumber : frameNumber), sourceFrameNumber);
+        thumbnail.release(); // Don't write into the Mat that was just given to the frame
+        update.frameDecoded();
+    }
+    
+    return framesOut;
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Frame
+   ----------------------------------------------------------------------------------------------------*/
+
+Frame::Frame(const Mat& dataIn, const int frameNumberIn, const double secondsIn, const int sourceFrameNumberIn)
+    : levels{ dataIn }, frameNumber{ frameNumberIn }, seconds{ secondsIn }, sourceFrameNumber{ sourceFrameNumberIn }
+{
+    while (levels.size() < maxLevels && levels.back().cols >= 2 && levels.back().rows >= 2)
+    {
+        const Mat& previous = levels.back();
+        Mat        next;
+        cv::resize(previous, next, cv::Size((previous.cols + 1)/2, (previous.rows + 1)/2), 0, 0, cv::INTER_AREA);
+        levels.push_back(next);
+    }
+}
+
+Mat Frame::getData(const int targetWidth) const
+{
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+        if (level->cols >= targetWidth)
+            return *level;
+    
+    return levels.front();
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Video
+   ----------------------------------------------------------------------------------------------------*/
+
+void Video::setFrameNumber(const int num)
+{
+    // A seek with cv::VideoCapture decodes frames immediately, so when a different engine might be
+    // used to decode the frame, the seek is deferred until we know it is actually needed
+    if (engine == DecodeEngine::eSeek)
+        seekReader(num);
+    else
+        requestedFrameNumber = num;
+}
+
+void Video::getCurrentFrame(Mat& frameOut)
+{
+    getCurrentFrame(frameOut, cv::Size{});
+}
+
+void Video::getCurrentFrame(Mat& frameOut, const cv::Size thumbnailSize)
+{
+    if (requestedFrameNumber < 0)
+    {
+        readFrame(frameOut, thumbnailSize);
+        return;
+    }
+    
+    int frameNumber      = requestedFrameNumber;
+    requestedFrameNumber = -1;
+    
+    if (engine == DecodeEngine::eFastScan && scanner)
+    {
+        Mat keyframe;
+        if (scanner->read(frameNumber, keyframe))
+        {
+            if (thumbnailSize.empty())
+                frameOut = keyframe;
+            else
+                makeThumbnail(keyframe, frameOut, thumbnailSize);
+            return;
+        }
+    }
+    
+    auto startTime = std::chrono::steady_clock::now();
+    
+    if (seekBeforeNextFrame)
+        seekReader(frameNumber);
+    else if (engine == DecodeEngine::eSequential || (engine == DecodeEngine::eHybrid && !plan.startsRun(frameNumber)))
+        skipToFrame(frameNumber);
+    else
+        seekReader(frameNumber);
+    
+    seekBeforeNextFrame = false;
+    
+    if (token.isCancelled()) // Decoding forward may have stopped before reaching the frame
+    {
+        frameOut.release();
+        return;
+    }
+    
+    readFrame(frameOut, thumbnailSize);
+    
+    if (engine == DecodeEngine::eHybrid)
+        plan.addActualCost(frameNumber, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+bool Video::decodeFrame(const int frameNumber, Mat& frameOut, const cv::Size thumbnailSize)
+{
+    if (decodeTimeout <= 0)
+    {
+        setFrameNumber(frameNumber);
+        getCurrentFrame(frameOut, thumbnailSize);
+        return true;
+    }
+    
+    // Copies of a video share its worker until one of them decodes with it, which then starts a worker of its own
+    if (!decodeWorker || decodeWorker.use_count() > 1)
+        decodeWorker = std::make_shared<DecodeWorker>();
+    
+    // The worker decodes with this video itself, moved into `decode` so that everything it uses is kept alive by the job, however long it takes
+    struct Decode
+    {
+        Video video;
+        Mat   frame;
+    };
+    
+    const int                     timeout { decodeTimeout };
+    std::shared_ptr<DecodeWorker> worker  { decodeWorker };
+    VideoReaderPtr                decoder { reader };
+    std::shared_ptr<Decode>       decode  { std::make_shared<Decode>() };
+    decode->video = std::move(*this);
+    
+    bool finished = worker->run([decode, frameNumber, thumbnailSize]() {
+        decode->video.setFrameNumber(frameNumber);
+        decode->video.getCurrentFrame(decode->frame, thumbnailSize);
+    }, timeout);
+    
+    if (finished)
+    {
+        *this    = std::move(decode->video); // Carry on from wherever the worker got to
+        frameOut = decode->frame;
+        return true;
+    }
+    
+    // The stuck decoder is left to the worker, which closes it once it finishes (if it ever does). Until then, the decoder gives up its
+    // share of the thread budget to the decoders that are still working
+    worker->abandon();
+    decoder->releaseThreads();
+    frameOut.release();
+    
+    // Decoding never changes the settings, so they can still be read while the worker runs. The frame scanner and plan are left with it
+    *this = decode->video.copySettings();
+    engine              = decode->video.engine;
+    token               = decode->video.token;
+    seekBeforeNextFrame = true; // Rather than decoding forward from the start of the video
+    
+    try
+    {
+        reader = openVideoReader(path, readerSettings);
+    }
+    catch (const FileException& exception)
+    {
+        std::cerr << exception.what(); // Leaves the unopened reader, from which every frame is empty
+    }
+    
+    return false;
+}
+
+int Video::getNextKeyframe(const int frameNumber) const
+{
+    if (index->isValid())
+    {
+        const vector<int>& keyframes = index->getKeyframes();
+        
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), frameNumber);
+        return next == keyframes.end() ? -1 : *next;
+    }
+    
+    // Otherwise the demuxer's packets (if the reader exposes them) say which are keyframes, numbered by their time stamps as the reader numbers frames
+    int next = -1;
+    for (const PacketInfo& packet : reader->getPackets())
+    {
+        int keyframe = static_cast<int>(std::lround(packet.seconds * getFPS()));
+        if (packet.isKeyframe && keyframe > frameNumber && (next < 0 || keyframe < next))
+            next = keyframe;
+    }
+    
+    return next;
+}
+
+void Video::skipToFrame(const int frameNumber)
+{
+    if (frameNumber < position)
+    {
+        seekReader(frameNumber);
+        return;
+    }
+    
+    while (position < frameNumber && !token.isCancelled() && grabFrame()) {}
+}
+
+void Video::seekReader(const int frameNumber)
+{
+    reader->seek(toReaderFrameNumber(frameNumber));
+    position = frameNumber;
+}
+
+bool Video::grabFrame()
+{
+    if (!reader->grab())
+        return false;
+    
+    DecodeWorker::heartbeat(); // Decoding forward is making progress, however long the run is (see decodeFrame())
+    ++position;
+    return true;
+}
+
+void Video::readFrame(Mat& frameOut, const cv::Size thumbnailSize)
+{
+    if (reader->read(frameOut, thumbnailSize))
+        ++position;
+}
+
+int Video::toReaderFrameNumber(const int frameNumber) const
+{
+    if (!index->hasTimestamps() || frameNumber < 0 || frameNumber >= index->getNumberOfFrames())
+        return frameNumber;
+    
+    return static_cast<int>(std::lround(index->getFrameSeconds(frameNumber) * reader->getFPS()));
+}
+
+double Video::getFrameSeconds(const int frameNumber) const
+{
+    if (index->hasTimestamps() && frameNumber >= 0 && frameNumber < index->getNumberOfFrames())
+        return index->getFrameSeconds(frameNumber);
+    
+    return frameNumberToSeconds(frameNumber, getFPS());
+}
+
+int Video::getFrameAtSeconds(const double seconds) const
+{
+    if (index->hasTimestamps())
+        return index->getFrameAtSeconds(seconds);
+    
+    return std::clamp(static_cast<int>(std::floor(seconds * getFPS() + 1e-6)), 0, std::max(getNumberOfFrames() - 1, 0));
+}
+
+double Video::getDurationSeconds() const
+{
+    if (index->hasTimestamps())
+        return index->getDurationSeconds();
+    
+    return frameNumberToSeconds(getNumberOfFrames(), getFPS());
+}
+
+void Video::prepareFrames(const vector<int>& frameNumbers)
+{
+    reader->prepareFrames(frameNumbers);
+    
+    if (index->hasSampleLocations())
+        reader->readAhead(getByteRanges(frameNumbers));
+    
+    scanner.reset();
+    plan = DecodePlan{};
+    
+    if (engine == DecodeEngine::eHybrid)
+        plan = DecodePlan(frameNumbers, costModel, *index, position);
+    
+    if (engine != DecodeEngine::eFastScan || !canFastScan())
+        return;
+    
+    vector<int> keyframes;
+    std::copy_if(frameNumbers.begin(), frameNumbers.end(), std::back_inserter(keyframes), [&](int frameNumber) { return index->isKeyframe(frameNumber); });
+    
+    if (keyframes.empty())
+        return;
+    
+    try
+    {
+        scanner = std::make_shared<FastScanner>(path, *index, keyframes);
+    }
+    catch (const FileException& exception)
+    {
+        std::cerr << exception.what();
+        scanner.reset();
+    }
+}
+
+vector<ByteRange> Video::getByteRanges(const vector<int>& frameNumbers) const
+{
+    const int reorderDepth = 4; // Frames after each frame whose samples may be stored before it (B-frames are stored after the frames they refer to)
+    const int lastFrame    = index->getNumberOfFrames() - 1;
+    
+    vector<ByteRange> ranges;
+    for (int frameNumber : frameNumbers)
+    {
+        if (frameNumber < 0 || frameNumber > lastFrame)
+            continue;
+        
+        // The samples from the keyframe to the frame are stored in decode order, which differs from presentation order by a few frames at most
+        // Frames before the first keyframe are decoded from the first sample
+        const int keyframe    = index->getPreviousKeyframe(frameNumber);
+        int       firstSample = (keyframe >= 0) ? index->getSampleNumber(keyframe) : 0;
+        int lastSample  = firstSample;
+        for (int frame = std::max(frameNumber - reorderDepth, 0); frame <= std::min(frameNumber + reorderDepth, lastFrame); ++frame)
+            lastSample = std::max(lastSample, index->getSampleNumber(frame));
+        
+        const uint64_t start = index->getSampleOffset(firstSample);
+        const uint64_t end   = index->getSampleOffset(lastSample) + index->getSampleSize(lastSample);
+        if (end <= start) // Samples aren't stored in order, so there's no single range to read
+            continue;
+        
+        if (!ranges.empty() && start >= ranges.back().offset && start <= ranges.back().offset + ranges.back().size)
+            ranges.back().size = std::max(ranges.back().offset + ranges.back().size, end) - ranges.back().offset;
+        else
+            ranges.push_back(ByteRange{ start, end - start });
+    }
+    
+    return ranges;
+}
+
+Video Video::reopen() const
+{
+    Video other { copySettings() };
+    other.reader = openVideoReader(path, readerSettings);
+    
+    return other;
+}
+
+Video Video::copySettings() const
+{
+    Video other;
+    other.path           = path;
+    other.index          = index;
+    other.costModel      = costModel;
+    other.readerSettings = readerSettings;
+    other.decodeTimeout  = decodeTimeout;
+    
+    return other;
+}
+
+void Video::measureDecodeCosts()
+{
+    const int probeFrames = 8; // The number of frames decoded forward when measuring the cost of a single frame
+    const int seekProbes  = 3; // The number of seeks timed when measuring the overhead of a seek
+    const int totalFrames = getNumberOfFrames();
+    
+    if (totalFrames < (seekProbes + 1)*(probeFrames + costModel.getSeekPreroll())) // Too short for the choice to matter
+        return;
+    
+    auto millisecondsSince = [](std::chrono::steady_clock::time_point start) { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+    
+    // 1. Decoding forward. The first frame is decoded before timing starts, as it includes the cost of starting the decoder
+    seekReader(0);
+    grabFrame();
+    
+    auto startTime = std::chrono::steady_clock::now();
+    int  grabbed   = 0;
+    while (grabbed < probeFrames && grabFrame())
+        ++grabbed;
+    
+    if (grabbed == 0)
+        return;
+    
+    double frameCost = millisecondsSince(startTime) / grabbed;
+    
+    // 2. Seeking, at points spread through the video. Whatever the frames decoded by the seek don't account for is overhead
+    double seekOverhead = 0.0;
+    Mat    probe;
+    for (int i = 1; i <= seekProbes; ++i)
+    {
+        int frameNumber = totalFrames*i / (seekProbes + 1);
+        
+        startTime = std::chrono::steady_clock::now();
+        seekReader(frameNumber);
+        readFrame(probe, cv::Size{});
+        seekOverhead += millisecondsSince(startTime) - frameCost*costModel.getFramesDecodedBySeek(frameNumber, *index);
+    }
+    
+    costModel = DecodeCostModel(costModel.getSeekPreroll(), std::max(seekOverhead/seekProbes, 0.0), frameCost);
+    seekReader(0);
+}
+
 
 /*----------------------------------------------------------------------------------------------------
     MARK: - VideoPreview
    ----------------------------------------------------------------------------------------------------*/
 
+VideoPreview::~VideoPreview()
+{
+    cancelUpdate();
+    prefetcher.reset(); // Stops the prefetcher's thread before `video` is destroyed
+}
+
+void VideoPreview::loadVideo()
+{
+    cancelUpdate(); // `video` is only ever changed while no update is reading it
+    
+    prefetcher.reset(); // The preview, prefetcher and zoom levels have their own decoder, which might be for a different file
+    selectedFrameNumber = -1;
+    previewDecoder.reset();
+    zoomDecoder.reset();
+    zoomStack.clear();
+    zoomCache.clear();
+    
+    video = Video(videoPath, chooseReaderSettings());
+    video.measureDecodeCosts();
+    
+    // Logged with the backend, so that the backends can be compared on the same file by changing "video_backend"
+    const DecodeCostModel& costs = video.getDecodeCostModel();
+    if (costs.isMeasured())
+        cout << "Decode costs for \"" << videoPath << "\" (" << videoBackendToString(video.getBackend()) << ", " << getThumbnailKernelName() << " thumbnail kernel): " << costs.getSeekOverhead() << " ms per seek, " << costs.getFrameCost() << " ms per frame\n";
+    
+    ThreadBudget::getInstance().print();
+}
+
+Video VideoPreview::openDecoder()
+{
+    Video decoder { video.reopen() };
+    decoder.setDecodeTimeout(getOption("decode_timeout_ms")->getValue()->getInt().value_or(0));
+    return decoder;
+}
+
 void VideoPreview::updatePreview()
 {
-    cout << "Updating preview\n";
-    printConfig();
+    cancelUpdate();
+    
+    currentUpdate = std::make_shared<PreviewUpdate>();
+    currentUpdate->addTask();
+    runUpdate(currentUpdate);
+    currentUpdate->taskDone();
+}
+
+PreviewUpdatePtr VideoPreview::updatePreviewAsync(const PreviewUpdate::Callback& onComplete)
+{
+    cancelUpdate();
+    
+    currentUpdate = std::make_shared<PreviewUpdate>(onComplete);
+    currentUpdate->addTask();
+    updateThread = std::thread([this, update = currentUpdate]() {
+        runUpdate(update);
+        update->taskDone();
+    });
+    
+    return currentUpdate;
+}
+
+void VideoPreview::cancelUpdate()
+{
+    if (currentUpdate)
+        currentUpdate->cancel();
+    
+    if (updateThread.joinable())
+        updateThread.join();
+    
+    if (refineThread.joinable())
+        refineThread.join();
+}
+
+void VideoPreview::selectFrame(const int frameNumber)
+{
+    cv::Size thumbnailSize;
+    {
+        std::lock_guard<std::mutex> lock { framesMutex };
+        thumbnailSize = framesSize;
+    }
+    
+    if (thumbnailSize.empty() || frameNumber < 0 || frameNumber >= video.getNumberOfFrames())
+        return;
+    
+    if (!prefetcher)
+    {
+        try
+        {
+            prefetcher = std::make_unique<FramePrefetcher>(openDecoder());
+        }
+        catch (const FileException& exception)
+        {
+            std::cerr << exception.what(); // Prefetching only makes stepping between frames faster, so the selection is still made
+        }
+    }
+    
+    selectedFrameNumber = frameNumber;
+    
+    if (prefetcher)
+        prefetcher->prefetchAround(frameNumber, getOption("prefetch_window")->getValue()->getInt().value(), thumbnailSize);
+}
+
+std::optional<Frame> VideoPreview::stepSelectedFrame(const int offset)
+{
+    if (selectedFrameNumber < 0)
+        return {};
+    
+    int frameNumber = selectedFrameNumber + offset;
+    
+    std::optional<Frame> frame = getStoredFrame(frameNumber);
+    if (!frame && prefetcher)
+        frame = prefetcher->getFrame(frameNumber);
+    if (frame)
+        selectFrame(frameNumber); // Keep the window centred on the selection, so that stepping again is also answered from memory
+    
+    return frame;
+}
+
+vector<Frame> VideoPreview::zoomIn(const int firstFrameNumber, const int lastFrameNumber)
+{
+    int first = std::max(std::min(firstFrameNumber, lastFrameNumber), 0);
+    int last  = std::min(std::max(firstFrameNumber, lastFrameNumber), video.getNumberOfFrames() - 1);
+    
+    // Every level uses the same number of frames as the preview, at the same size
+    vector<int> frameNumbers;
+    cv::Size    thumbnailSize;
+    std::map<int, Frame> decodedFrames; // The frames that have already been decoded at `thumbnailSize`
+    {
+        std::lock_guard<std::mutex> lock { framesMutex };
+        frameNumbers  = getIntervalFrameNumbers(first, last, std::max(static_cast<int>(targetFrameNumbers.size()), 2));
+        thumbnailSize = framesSize;
+        decodedFrames = frameStore;
+    }
+    
+    if (thumbnailSize != zoomCacheSize)
+    {
+        zoomCache.clear();
+        zoomCacheSize = thumbnailSize;
+    }
+    
+    auto cachedLevel = zoomCache.find({ first, last });
+    if (cachedLevel != zoomCache.end())
+    {
+        zoomStack.push_back(cachedLevel->second);
+        return cachedLevel->second->frames;
+    }
+    
+    for (const auto& [interval, level] : zoomCache)
+        for (const Frame& frame : level->frames)
+            decodedFrames.emplace(frame.getFrameNumber(), frame);
+    
+    vector<int> framesToDecode;
+    for (int frameNumber : frameNumbers)
+    {
+        if (decodedFrames.find(frameNumber) != decodedFrames.end())
+            continue;
+        
+        std::optional<Frame> prefetchedFrame = prefetcher ? prefetcher->getCachedFrame(frameNumber) : std::nullopt;
+        if (prefetchedFrame && prefetchedFrame->getData().size() == thumbnailSize)
+            decodedFrames.emplace(frameNumber, prefetchedFrame.value());
+        else
+            framesToDecode.push_back(frameNumber);
+    }
+    
+    cout << "Zooming into frames " << first << " to " << last << ": reusing " << frameNumbers.size() - framesToDecode.size() << " frames, decoding " << framesToDecode.size() << "\n";
+    
+    // A zoom level covers a short stretch of the video, so the frames are decoded on a single decoder that is kept between
+    // levels. The hybrid engine then decodes forward from wherever the last level left off whenever that is cheaper than seeking
+    if (!framesToDecode.empty())
+    {
+        if (!zoomDecoder)
+        {
+            try
+            {
+                zoomDecoder = openDecoder();
+            }
+            catch (const FileException& exception)
+            {
+                std::cerr << exception.what();
+                return getZoomFrames();
+            }
+        }
+        
+        PreviewUpdate   update;
+        SegmentDecoders noSegmentDecoders; // Only used with more than one thread
+        update.addFramesToDecode(framesToDecode.size());
+        for (const Frame& frame : extractFrames(zoomDecoder.value(), noSegmentDecoders, framesToDecode, DecodeEngine::eHybrid, thumbnailSize, 1, update))
+            decodedFrames.emplace(frame.getFrameNumber(), frame);
+    }
+    
+    ZoomLevelPtr level { std::make_shared<ZoomLevel>(ZoomLevel{ first, last, {} }) };
+    level->frames.reserve(frameNumbers.size());
+    for (int frameNumber : frameNumbers)
+    {
+        auto frame = decodedFrames.find(frameNumber);
+        if (frame != decodedFrames.end())
+            level->frames.push_back(frame->second);
+    }
+    
+    zoomCache.emplace(std::make_pair(first, last), level);
+    zoomStack.push_back(level);
+    return level->frames;
+}
 
-    // Make a new set of frames if the number of frames has changed
-    if ( configOptionHasBeenChanged("maximum_frames") || configOptionHasBeenChanged("maximum_percentage") || configOptionHasBeenChanged("minimum_sampling") || configOptionHasBeenChanged("frames_to_show") || !guiInfo.isPreviewUpToDate() )
-        makeFrames();
+std::optional<Frame> VideoPreview::getStoredFrame(const int frameNumber)
+{
+    std::lock_guard<std::mutex> lock { framesMutex };
+    
+    auto frame = frameStore.find(frameNumber);
+    if (frame == frameStore.end() || frame->second.getData().size() != framesSize)
+        return {};
+    
+    return frame->second;
+}
+
+vector<Frame> VideoPreview::zoomOut()
+{
+    if (!zoomStack.empty())
+        zoomStack.pop_back();
+    
+    return getZoomFrames();
+}
+
+void VideoPreview::setOptionAndUpdate(const std::function<void()>& changeOption)
+{
+    cancelUpdate();
+    
+    {
+        std::lock_guard<std::recursive_mutex> lock { optionsMutex };
+        changeOption();
+    }
+    
+    updatePreviewAsync();
+}
 
+void VideoPreview::runUpdate(const PreviewUpdatePtr& update)
+{
+    // The options are only locked while they are read, so that they can still be read (e.g. by the GUI) while frames are decoded
+    bool framesNeedRemaking {};
+    {
+        std::lock_guard<std::recursive_mutex> lock { optionsMutex };
+        
+        cout << "Updating preview\n";
+        printConfig();
+        
+        // Make a new set of frames if the number of frames has changed (or the last update was cancelled before it finished)
+        framesNeedRemaking = getCompleteness() < 1.0 || configOptionHasBeenChanged("maximum_frames") || configOptionHasBeenChanged("maximum_percentage") || configOptionHasBeenChanged("minimum_sampling") || configOptionHasBeenChanged("frames_to_show") || configOptionHasBeenChanged("sampling_mode") || configOptionHasBeenChanged("sampling_schedule") || configOptionHasBeenChanged("decode_engine") || configOptionHasBeenChanged("thumbnail_width") || !guiInfo.isPreviewUpToDate();
+    }
+    
+    if (framesNeedRemaking)
+        makeFrames(update);
+    
+    // If the update was cancelled, or frames are still being decoded in the background (e.g. after "time_budget_ms" ran out), the options
+    // it was given haven't been fully applied. An incomplete preview is always remade, and a complete one isn't decoded again if it matches
+    if (update->isCancelled() || getCompleteness() < 1.0)
+        return;
+    
     // Update `currentPreviewConfigOptions` (we explicitly don't want them to point to the same resource)
+    std::lock_guard<std::recursive_mutex> lock { optionsMutex };
     currentPreviewConfigOptions.clear();
     for (ConfigOptionPtr opt : optionsHandler.getOptions())
         currentPreviewConfigOptions.push_back(std::make_shared<ConfigOption>(opt->getID(),opt->getValue()));
@@ -50,6 +764,8 @@ void VideoPreview::updatePreview()
 
 ConfigOptionPtr VideoPreview::getOption(const string& optionID)
 {
+    std::lock_guard<std::recursive_mutex> lock { optionsMutex };
+    
     // Search for optionID in the video previews current set of config options
     // ConfigOptionVector.getOption() return nullptr if the option doesn't exist
     ConfigOptionPtr option = optionsHandler.getOptions().getOption(optionID);
@@ -74,6 +790,8 @@ ConfigOptionPtr VideoPreview::getOption(const string& optionID)
 
 void VideoPreview::saveOptions(ConfigOptionVector options, const string& filePath)
 {
+    std::lock_guard<std::recursive_mutex> lock { optionsMutex };
+    
     // There are two cases to deal with: either filePath corresponds to a preexisting
     // configuration file (with a corresponding ConfigFile in optionsHandler), or to an
     // arbitrary file. I think of the first case as "saving" the options, and the second
@@ -131,8 +849,36 @@ void VideoPreview::saveOptions(ConfigOptionVector options, const string& filePat
     }
 }
 
-void VideoPreview::makeFrames()
+void VideoPreview::makeFrames(const PreviewUpdatePtr& update)
 {
+    // With a time budget, everything from here on has to fit within it
+    std::optional<int> timeBudget { getOption("time_budget_ms")->getValue()->getInt() };
+    auto               startTime  { std::chrono::steady_clock::now() };
+    if (timeBudget)
+        update->setDeadline(startTime + std::chrono::milliseconds(timeBudget.value()));
+    
+    // The preview is decoded with a decoder of its own, so that `video` is never changed while the GUI may be reading it
+    // It is kept between updates, so that it carries on from wherever it got to
+    if (!previewDecoder)
+    {
+        try
+        {
+            previewDecoder = openDecoder();
+        }
+        catch (const FileException& exception)
+        {
+            std::cerr << exception.what();
+            return;
+        }
+    }
+    Video& decoder { previewDecoder.value() };
+    
+    // Decoders opened from here on (for extracting in parallel) share the same limit
+    decoder.setDecodeTimeout(getOption("decode_timeout_ms")->getValue()->getInt().value_or(0));
+    
+    // Every batch and pass of this update shares the same decoders for extracting in parallel, rather than each opening its own
+    SegmentDecoders segmentDecoders;
+    
     // 1. Determine the maximum number of frames allowed to be displayed
     int totalFrames   = video.getNumberOfFrames();                                     // The number of frames in the video
     
@@ -161,8 +907,8 @@ void VideoPreview::makeFrames()
     
     if (getOption("frames_to_show")->getValue()->getString().has_value()) // frames_to_show value is "auto"
     {
-        NFrames = std::min(maximumFramesToShow, guiInfo.getRows()*guiInfo.getCols());
         guiInfo.previewHasBeenUpdated();
+        NFrames = std::min(maximumFramesToShow, guiInfo.getRows()*guiInfo.getCols());
     }
     else
         NFrames = maximumFramesToShow * getOption("frames_to_show")->getValue()->getDouble().value();
@@ -170,26 +916,481 @@ void VideoPreview::makeFrames()
     if (NFrames == 0)
         NFrames = 1;
     
-    // 3. Make the new frames (only if the number of frames has changed)
-    if (frames.size() == NFrames)
+    // 3. Make the new frames (only if the frames to sample have changed, or the current frames are too small)
+    vector<int> frameNumbers  { getSampleFrameNumbers(NFrames) };
+    cv::Size    thumbnailSize { chooseThumbnailSize() };
+    
+    // The GUI thread reads these (e.g. to zoom in) while the update runs, so they are only changed while holding the lock
+    vector<int> framesToDecode;
+    {
+        std::lock_guard<std::mutex> lock { framesMutex };
+        
+        if (frameNumbers == targetFrameNumbers && thumbnailSize.width <= framesSize.width && completeness == 1.0)
+            return;
+        
+        targetFrameNumbers = frameNumbers;
+        
+        // Frames that were decoded for a previous preview can be reused, as long as they are big enough
+        if (thumbnailSize.width > framesSize.width)
+            frameStore.clear();
+        
+        framesSize = thumbnailSize;
+        
+        for (int frameNumber : frameNumbers)
+            if (frameStore.find(frameNumber) == frameStore.end())
+                framesToDecode.push_back(frameNumber);
+        
+        reusedFrameCount  = frameNumbers.size() - framesToDecode.size();
+        decodedFrameCount = framesToDecode.size();
+    }
+    cout << "Making " << frameNumbers.size() << " frames: " << frameNumbers.size() - framesToDecode.size() << " reused, " << framesToDecode.size() << " to decode\n";
+    update->addFramesToDecode(framesToDecode.size());
+    
+    DecodeEngine engine { chooseDecodeEngine() };
+    
+    if (timeBudget)
+    {
+        extractWithinBudget(decoder, segmentDecoders, framesToDecode, engine, thumbnailSize, startTime, timeBudget.value(), *update);
+        
+        // Once the budget has run out, the frames it didn't reach are decoded in the background, as "progressive_preview" does, unless the
+        // update was cancelled. They're decoded with the preview's decoder, which this thread has finished with (and the next update waits for)
+        update->setDeadline(CancellationToken::Clock::time_point::max());
+        
+        vector<int> remainingFrames;
+        {
+            std::lock_guard<std::mutex> lock { framesMutex };
+            for (int frameNumber : framesToDecode)
+                if (frameStore.find(frameNumber) == frameStore.end())
+                    remainingFrames.push_back(frameNumber);
+        }
+        
+        if (remainingFrames.empty() || update->isCancelled())
+            return;
+        
+        update->addTask();
+        refineThread = std::thread([this, segmentDecoders = std::move(segmentDecoders), remainingFrames, engine, thumbnailSize, update]() mutable {
+            extractInViewportOrder(previewDecoder.value(), segmentDecoders, remainingFrames, engine, thumbnailSize, *update);
+            update->taskDone();
+        });
         return;
+    }
+    
+    const int  coarseStep  = 8; // The coarse preview has one frame for every `coarseStep` frames that need decoding
+    const int  coarseScale = 4; // ... at 1/`coarseScale` of the width and height
+    const bool progressive = getOption("progressive_preview")->getValue()->getBool().value() && framesToDecode.size() >= 2*coarseStep;
+    
+    if (!progressive)
+    {
+        extractInViewportOrder(decoder, segmentDecoders, framesToDecode, engine, thumbnailSize, *update);
+        return;
+    }
+    
+    // 4. Publish a coarse preview straight away: the keyframes nearest to some of the frames, which are the cheapest frames to decode, at a small size
+    vector<int> coarseFrameNumbers;
+    for (size_t i = 0; i < framesToDecode.size(); i += coarseStep)
+    {
+        int keyframe = video.getNearestKeyframe(framesToDecode[i]);
+        if (coarseFrameNumbers.empty() || coarseFrameNumbers.back() != keyframe)
+            coarseFrameNumbers.push_back(keyframe);
+    }
+    
+    cv::Size coarseSize { std::max(thumbnailSize.width/coarseScale, 1), std::max(thumbnailSize.height/coarseScale, 1) };
+    update->addFramesToDecode(coarseFrameNumbers.size());
+    publishFrames({}, extractFrames(decoder, segmentDecoders, coarseFrameNumbers, chooseDecodeEngine(), coarseSize, chooseExtractionThreads(static_cast<int>(coarseFrameNumbers.size())), *update));
+    
+    if (update->isCancelled())
+        return;
+    
+    // 5. Decode the actual frames in the background, in passes that each halve the gaps between the frames decoded so far
+    vector<vector<int>> passes;
+    for (size_t step = coarseStep; step >= 1; step /= 2)
+    {
+        vector<int> pass;
+        for (size_t i = 0; i < framesToDecode.size(); i += step)
+            if (step == coarseStep || i % (2*step) != 0)
+                pass.push_back(framesToDecode[i]);
+        passes.push_back(pass);
+    }
+    
+    try
+    {
+        Video refineDecoder { openDecoder() };
+        update->addTask();
+        refineThread = std::thread(&VideoPreview::refineFrames, this, refineDecoder, passes, engine, thumbnailSize, update);
+    }
+    catch (const FileException& exception)
+    {
+        std::cerr << exception.what();
+        extractInViewportOrder(decoder, segmentDecoders, framesToDecode, engine, thumbnailSize, *update);
+    }
+}
+
+void VideoPreview::refineFrames(Video decoder, const vector<vector<int>> passes, const DecodeEngine engine, const cv::Size thumbnailSize, const PreviewUpdatePtr update)
+{
+    SegmentDecoders segmentDecoders; // Shared by every pass
+    for (const vector<int>& pass : passes)
+        extractInViewportOrder(decoder, segmentDecoders, pass, engine, thumbnailSize, *update);
+    
+    update->taskDone();
+}
+
+void VideoPreview::extractInViewportOrder(Video& decoder, SegmentDecoders& segmentDecoders, vector<int> frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, PreviewUpdate& update)
+{
+    // Frames decoded before the update was cancelled are still published, since they are still correct (and will be reused)
+    while (!frameNumbers.empty() && !update.isCancelled())
+    {
+        vector<int> batch { takeNextBatch(frameNumbers) };
+        publishFrames(extractFrames(decoder, segmentDecoders, batch, engine, thumbnailSize, chooseExtractionThreads(static_cast<int>(batch.size())), update));
+    }
+}
+
+void VideoPreview::extractWithinBudget(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& framesToDecode, const DecodeEngine engine, const cv::Size thumbnailSize, const std::chrono::steady_clock::time_point startTime, const int budget, PreviewUpdate& update)
+{
+    // Passes in bisection order of position in the preview: the first frame and one about halfway along, then the frames halfway between
+    // those, and so on. Each pass halves the gaps left by the passes before it, so the frames decoded by the time the budget runs out are
+    // spread through the whole video, wherever it runs out
+    size_t topStep = 1;
+    while (2*topStep < targetFrameNumbers.size())
+        topStep *= 2;
+    
+    vector<vector<int>> passes;
+    for (size_t step = topStep; step >= 1; step /= 2)
+    {
+        vector<int> pass;
+        for (size_t i = 0; i < targetFrameNumbers.size(); i += step)
+            if (step == topStep || i % (2*step) != 0)
+                if (std::binary_search(framesToDecode.begin(), framesToDecode.end(), targetFrameNumbers[i]))
+                    pass.push_back(targetFrameNumbers[i]);
+        passes.push_back(pass);
+    }
+    
+    // Frames decoded after the deadline are dropped (see decodeFrames()), so the last pass may only be partly published
+    size_t decodedCount = 0;
+    for (const vector<int>& pass : passes)
+    {
+        if (update.isCancelled())
+            break;
+        
+        vector<Frame> newFrames { extractFrames(decoder, segmentDecoders, pass, engine, thumbnailSize, chooseExtractionThreads(static_cast<int>(pass.size())), update) };
+        decodedCount += newFrames.size();
+        publishFrames(newFrames);
+    }
     
+    // Whatever wasn't decoded is left pending, to be decoded in the background (see makeFrames())
+    const long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    {
+        std::lock_guard<std::mutex> lock { framesMutex };
+        timeBudgetUsed = elapsed;
+    }
+    cout << "Time budget: decoded " << decodedCount << " of " << framesToDecode.size() << " frames in " << elapsed << " of " << budget << " ms (" << getNumOfPendingFrames() << " frames pending)\n";
+}
+
+vector<int> VideoPreview::takeNextBatch(vector<int>& frameNumbers)
+{
+    const int minBatchSize = 8; // Smaller batches make it harder for the decoder to reuse its position between frames
+    
+    int    firstRow {}, lastRow {}, cols {};
+    double velocity {};
+    
+    // Without knowing what is on screen, everything is equally urgent
+    if (!guiInfo.getViewport(firstRow, lastRow, cols, velocity) || cols <= 0)
+    {
+        vector<int> batch;
+        batch.swap(frameNumbers);
+        return batch;
+    }
+    
+    // How soon the frames in `row` are needed. Visible rows come first, then the rest by how far they are from the screen.
+    // Rows the preview is scrolling towards count as nearer, the faster it scrolls
+    auto rowPriority = [=](const int row) {
+        if (row >= firstRow && row <= lastRow)
+            return 0.0;
+        
+        const bool   ahead    = (row > lastRow) ? velocity > 0 : velocity < 0;
+        const double distance = (row > lastRow) ? row - lastRow : firstRow - row;
+        return ahead ? distance / (1.0 + std::abs(velocity)) : distance;
+    };
+    
+    // The row a frame is shown in follows from its position among the frames in the complete preview
+    vector<std::pair<double, int>> prioritisedFrames;
+    prioritisedFrames.reserve(frameNumbers.size());
+    for (int frameNumber : frameNumbers)
+    {
+        int position = static_cast<int>(std::lower_bound(targetFrameNumbers.begin(), targetFrameNumbers.end(), frameNumber) - targetFrameNumbers.begin());
+        prioritisedFrames.emplace_back(rowPriority(position / cols), frameNumber);
+    }
+    std::sort(prioritisedFrames.begin(), prioritisedFrames.end());
+    
+    // Every visible frame is decoded in the first batch; later batches have a few rows' worth of frames
+    size_t visibleFrames = std::count_if(prioritisedFrames.begin(), prioritisedFrames.end(), [](const std::pair<double, int>& frame) { return frame.first == 0.0; });
+    size_t batchSize     = std::min(std::max({ visibleFrames, static_cast<size_t>(cols), static_cast<size_t>(minBatchSize) }), prioritisedFrames.size());
+    
+    vector<int> batch;
+    for (size_t i = 0; i < batchSize; ++i)
+        batch.push_back(prioritisedFrames[i].second);
+    std::sort(batch.begin(), batch.end());
+    
+    frameNumbers.clear();
+    for (size_t i = batchSize; i < prioritisedFrames.size(); ++i)
+        frameNumbers.push_back(prioritisedFrames[i].second);
+    std::sort(frameNumbers.begin(), frameNumbers.end());
+    
+    return batch;
+}
+
+void VideoPreview::publishFrames(const vector<Frame>& newFrames, const vector<Frame>& placeholderFrames)
+{
+    std::lock_guard<std::mutex> lock { framesMutex };
+    
+    for (const Frame& frame : newFrames)
+        frameStore.emplace(frame.getFrameNumber(), frame);
+    
+    // Every target frame that has been decoded, plus any placeholders, in order
     frames.clear();
+    size_t decodedTargets = 0;
+    auto   placeholder    = placeholderFrames.begin();
+    for (int frameNumber : targetFrameNumbers)
+    {
+        for (; placeholder != placeholderFrames.end() && placeholder->getFrameNumber() <= frameNumber; ++placeholder)
+            if (placeholder->getFrameNumber() < frameNumber || frameStore.find(frameNumber) == frameStore.end())
+                frames.push_back(*placeholder);
+        
+        auto frame = frameStore.find(frameNumber);
+        if (frame != frameStore.end())
+        {
+            frames.push_back(frame->second);
+            ++decodedTargets;
+        }
+    }
+    frames.insert(frames.end(), placeholder, placeholderFrames.end());
+    
+    ++framesVersion;
+    completeness = targetFrameNumbers.empty() ? 1.0 : static_cast<double>(decodedTargets) / targetFrameNumbers.size();
+    pendingFrameCount = targetFrameNumbers.size() - decodedTargets;
+    
+    if (completeness < 1.0)
+        return;
+    
+    // Frames that aren't shown are kept for if the preview grows again, but only up to as many as are shown
+    if (frameStore.size() > 2*frames.size())
+    {
+        std::map<int, Frame> shownFrames;
+        for (const Frame& frame : frames)
+            shownFrames.emplace(frame.getFrameNumber(), frame);
+        frameStore.swap(shownFrames);
+    }
+}
+
+vector<Frame> VideoPreview::extractFrames(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, const int NThreads, PreviewUpdate& update)
+{
+    if (frameNumbers.empty())
+        return {};
+    
+    auto startTime = std::chrono::steady_clock::now();
+    
+    vector<Frame> newFrames { NThreads > 1 ? extractFramesInParallel(decoder, segmentDecoders, frameNumbers, engine, thumbnailSize, NThreads, update) : decodeFrames(decoder, engine, frameNumbers, thumbnailSize, update) };
+    
+    auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    cout << "Decoded " << newFrames.size() << " frames (" << thumbnailSize.width << "x" << thumbnailSize.height << ") in " << elapsedTime.count() << " ms (" << decodeEngineToString(engine) << ", " << NThreads << (NThreads == 1 ? " thread" : " threads");
+    if (elapsedTime.count() > 0)
+        cout << ", " << 1000*newFrames.size()/elapsedTime.count() << " frames/s";
+    cout << ")\n";
+    
+    if (engine == DecodeEngine::eHybrid && NThreads == 1)
+    {
+        decoder.getDecodePlan().print();
+        
+        std::lock_guard<std::mutex> lock { framesMutex };
+        decodePlan = decoder.getDecodePlan();
+    }
+    
+    return newFrames;
+}
+
+vector<int> VideoPreview::getSampleFrameNumbers(const int NFrames)
+{
+    int  totalFrames     = video.getNumberOfFrames();
+    bool snapToKeyframes = ( getOption("sampling_mode")->getValue()->getString().value() == "keyframe" );
+    
+    // The fast scan engine can only decode keyframes
+    if (getOption("decode_engine")->getValue()->getString().value() == "fast_scan")
+        snapToKeyframes = true;
     
-    double frameSampling = static_cast<double>(totalFrames)/NFrames;
-    double frameNumber   = 0.0;
-    while (frameNumber < totalFrames)
+    if (snapToKeyframes && !video.hasKeyframeIndex())
     {
-        int frameNumberInt = static_cast<int>(round(frameNumber));
-        if (frameNumberInt >= video.getNumberOfFrames())
+        std::cerr << "\tKeyframes could not be determined for \"" << videoPath << "\"; sampling exact frames instead\n";
+        snapToKeyframes = false;
+    }
+    
+    bool nested = ( getOption("sampling_schedule")->getValue()->getString().value() == "nested" );
+    
+    // The position of each sample point, as a fraction of the way through the video
+    vector<double> samplePositions (NFrames);
+    for (int i = 0; i < NFrames; ++i)
+        samplePositions[i] = nested ? vanDerCorput(i) : static_cast<double>(i)/NFrames;
+    std::sort(samplePositions.begin(), samplePositions.end());
+    
+    vector<int> frameNumbers;
+    frameNumbers.reserve(NFrames);
+    
+    // Sample points are spread evenly in time rather than by frame number, which (for variable frame rate video) would bunch them up where the
+    // frame rate is high. Each sample is the frame shown at its sample point
+    const double duration = video.getDurationSeconds();
+    
+    for (double position : samplePositions)
+    {
+        int frameNumberInt = video.getFrameAtSeconds(position*duration);
+        if (frameNumberInt >= totalFrames)
             break;
-            
-        Mat currentFrameMat;
-        video.setFrameNumber(frameNumberInt);
-        video.getCurrentFrame(currentFrameMat);
-        frames.emplace_back(currentFrameMat, static_cast<int>(round(frameNumber)), video.getFPS());
-        frameNumber += frameSampling;
+        
+        // Decoding a keyframe doesn't require decoding any of the frames before it, so snapping each
+        // sample point to its nearest keyframe means each frame in the preview costs a single decode
+        if (snapToKeyframes)
+            frameNumberInt = video.getNearestKeyframe(frameNumberInt);
+        
+        // Neighbouring sample points can snap to the same keyframe
+        if (frameNumbers.empty() || frameNumbers.back() != frameNumberInt)
+            frameNumbers.push_back(frameNumberInt);
     }
+    
+    return frameNumbers;
+}
+
+VideoReaderSettings VideoPreview::chooseReaderSettings()
+{
+    VideoReaderSettings settings;
+    settings.backend          = getOption("video_backend")->getValue()->getString().value() == "libav" ? VideoBackend::eLibav : VideoBackend::eOpenCV;
+    settings.defaultFPS       = getOption("default_fps")->getValue()->getInt().value();
+    
+    return settings;
+}
+
+DecodeEngine VideoPreview::chooseDecodeEngine()
+{
+    string engineOption = getOption("decode_engine")->getValue()->getString().value();
+    
+    if (engineOption == "seek")
+        return DecodeEngine::eSeek;
+    
+    if (engineOption == "sequential")
+        return DecodeEngine::eSequential;
+    
+    if (engineOption == "fast_scan")
+    {
+        if (video.canFastScan())
+            return DecodeEngine::eFastScan;
+        
+        std::cerr << "\tKeyframes cannot be decoded on their own for \"" << videoPath << "\"; seeking to each frame instead\n";
+        return DecodeEngine::eSeek;
+    }
+    
+    // "auto": choose between seeking and decoding forward for each frame based on the measured costs for this file
+    return DecodeEngine::eHybrid;
+}
+
+cv::Size VideoPreview::chooseThumbnailSize()
+{
+    cv::Size       videoSize { video.getDimensions() };
+    ConfigValuePtr value     { getOption("thumbnail_width")->getValue() };
+    
+    int width {};
+    if (value->getInt())
+        width = value->getInt().value();
+    else // thumbnail_width value is "auto": the width of the largest frames the GUI shows
+        width = static_cast<int>(std::ceil(guiInfo.getFrameWidthInPixels(1.0)));
+    
+    if (width <= 0 || width >= videoSize.width || videoSize.height <= 0)
+        return videoSize;
+    
+    int height = static_cast<int>(std::lround(static_cast<double>(videoSize.height) * width / videoSize.width));
+    return cv::Size(width, std::max(height, 1));
+}
+
+int VideoPreview::chooseExtractionThreads(const int NFrames)
+{
+    const int minFramesPerThread = 4; // Opening a decoder has a cost of its own, so don't open one for only a couple of frames
+    const int maxAutoThreads     = 8; // Each thread also opens a decoder, which needs threads of its own, so more than this rarely helps
+    
+    ConfigValuePtr value = getOption("extraction_threads")->getValue();
+    
+    int NThreads {};
+    if (value->getInt())
+        NThreads = value->getInt().value();
+    else // extraction_threads value is "auto": as many as the thread budget can spare, given what the other open videos are using
+        NThreads = ThreadBudget::getInstance().getWorkerShare(maxAutoThreads);
+    
+    return std::max(std::min(NThreads, NFrames / minFramesPerThread), 1);
+}
+
+vector<Frame> VideoPreview::extractFramesInParallel(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, const int NThreads, PreviewUpdate& update)
+{
+    // Held until every thread has finished, so that the decoders the threads open share what the threads leave of the budget
+    ThreadAllocationPtr workers { ThreadBudget::getInstance().allocateWorkers(NThreads, "extracting frames from \"" + videoPath + "\"") };
+    
+    // Each segment gets (almost) the same number of frames, which is the same amount of work when the frames are evenly spaced
+    vector<vector<int>> segments (NThreads);
+    for (size_t i = 0; i < frameNumbers.size(); ++i)
+        segments[i*NThreads / frameNumbers.size()].push_back(frameNumbers[i]);
+    
+    // Made big enough before any thread starts, as each thread opens its own decoder in place
+    if (segmentDecoders.size() < segments.size())
+        segmentDecoders.resize(segments.size());
+    
+    vector<std::future<vector<Frame>>> segmentResults;
+    segmentResults.reserve(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i)
+        segmentResults.push_back(std::async(std::launch::async, [&decoder, &segmentVideo = segmentDecoders[i], engine, thumbnailSize, &segment = segments[i], &update]() {
+            if (!segmentVideo)
+                segmentVideo = decoder.reopen();
+            return decodeFrames(segmentVideo.value(), engine, segment, thumbnailSize, update);
+        }));
+    
+    // Wait for every thread before touching `decoder` again, since the threads use it to open their own decoders
+    vector<vector<Frame>> segmentFrames (segments.size());
+    vector<size_t>        failedSegments;
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        try
+        {
+            segmentFrames[i] = segmentResults[i].get();
+        }
+        catch (const FileException& exception)
+        {
+            std::cerr << exception.what();
+            failedSegments.push_back(i);
+        }
+    }
+    
+    // Any segment that couldn't get its own decoder is decoded by `decoder` instead
+    for (size_t i : failedSegments)
+        segmentFrames[i] = decodeFrames(decoder, engine, segments[i], thumbnailSize, update);
+    
+    vector<Frame> framesOut;
+    framesOut.reserve(frameNumbers.size());
+    for (const vector<Frame>& segment : segmentFrames)
+        framesOut.insert(framesOut.end(), segment.begin(), segment.end());
+    
+    return framesOut;
+}
+
+vector<int> VideoPreview::getIntervalFrameNumbers(const int firstFrameNumber, const int lastFrameNumber, const int NFrames)
+{
+    int length = lastFrameNumber - firstFrameNumber;
+    
+    vector<int> frameNumbers;
+    if (length + 1 <= NFrames)
+    {
+        for (int i = firstFrameNumber; i <= lastFrameNumber; ++i)
+            frameNumbers.push_back(i);
+        return frameNumbers;
+    }
+    
+    frameNumbers.reserve(NFrames);
+    for (int i = 0; i < NFrames; ++i)
+        frameNumbers.push_back(firstFrameNumber + static_cast<int>(std::round(static_cast<double>(i) * length / (NFrames - 1))));
+    
+    frameNumbers.erase(std::unique(frameNumbers.begin(), frameNumbers.end()), frameNumbers.end());
+    return frameNumbers;
 }
 
 bool VideoPreview::configOptionHasBeenChanged(const string& optionID)
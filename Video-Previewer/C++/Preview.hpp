@@ -19,7 +19,20 @@
 #endif
 #endif
 
+#include <atomic> // for std::atomic
+#include <chrono> // for std::chrono::steady_clock
+#include <map>    // for std::map
+#include <memory> // for std::unique_ptr
+#include <mutex>  // for std::mutex
+#include <thread> // for std::thread
+
 #include "Configuration.hpp"
+#include "ContainerIndex.hpp"
+#include "FastScan.hpp"
+#include "DecodePlan.hpp"
+#include "DecodeWorker.hpp"
+#include "PreviewUpdate.hpp"
+#include "VideoReader.hpp"
 
 using cv::Mat;
 
@@ -30,9 +43,13 @@ using cv::Mat;
 // Convert an integer representing a number of seconds to a timestamp of the form hh:mm:ss
 string secondsToTimeStamp(const double seconds);
 
+// Human-readable name of a `DecodeEngine`, for diagnostics
+enum class DecodeEngine;
+string decodeEngineToString(const DecodeEngine engine);
+
 // Convert a frame number to a number of seconds (requires knowledge of the fps of the video)
-// Rounds down to the nearest integer
-double frameNumberToSeconds(const int frameNumber, const int fps);
+// Only correct for constant frame rate video; see Video::getFrameSeconds()
+double frameNumberToSeconds(const int frameNumber, const double fps);
 
 
 /*----------------------------------------------------------------------------------------------------
@@ -43,26 +60,55 @@ double frameNumberToSeconds(const int frameNumber, const int fps);
 class Frame
 {
 public:
-    Frame(const Mat& dataIn, const int frameNumberIn, const double fps)
-        : data{ dataIn }, frameNumber{ frameNumberIn }, seconds{ frameNumberToSeconds(frameNumberIn, fps) }
-    {}
+    // Builds the pyramid from `dataIn` straight away, so `dataIn` should be the largest size the frame will ever be shown at
+    // `dataIn` is 8-bit RGB, as made by VideoReader::retrieveThumbnail(), so the GUI can show it without converting it
+    Frame(const Mat& dataIn, const int frameNumberIn, const double secondsIn) : Frame(dataIn, frameNumberIn, secondsIn, frameNumberIn) {}
+    
+    // A frame standing in for `frameNumberIn`, which couldn't be decoded in time (see Video::decodeFrame()). `dataIn` is frame `sourceFrameNumberIn`
+    // (shown at `secondsIn`) instead, or empty (with `sourceFrameNumberIn` -1) if no other frame could be decoded either
+    Frame(const Mat& dataIn, const int frameNumberIn, const double secondsIn, const int sourceFrameNumberIn);
     
-    Mat    getData()                     const { return data; }
+    Mat    getData()                     const { return levels.front(); }
     int    getFrameNumber()              const { return frameNumber; }
     int    getFrameNumberHumanReadable() const { return frameNumber + 1; } // OpenCV indexes frames from 0
     string gettimeStampString()          const { return secondsToTimeStamp(seconds); }
+    
+    // The frame whose data this actually is, which differs from getFrameNumber() when the frame was given up on
+    int    getSourceFrameNumber()        const { return sourceFrameNumber; }
+    bool   isSubstitute()                const { return sourceFrameNumber >= 0 && sourceFrameNumber != frameNumber; }
+    bool   isSkipped()                   const { return sourceFrameNumber < 0; }
+    
+    // Return the smallest level of the pyramid that is at least `targetWidth` pixels wide (the largest level if none are)
+    Mat    getData(const int targetWidth) const;
 
 private:
-    Mat    data;
-    int    frameNumber;
-    double seconds;
+    vector<Mat> levels;      // levels[0] is the frame as decoded; each level after that is half the width and height of the one before
+    int         frameNumber;
+    double      seconds;
+    int         sourceFrameNumber; // See getSourceFrameNumber()
+    
+    const static int maxLevels = 4; // Down to 1/8 of the decoded size
+};
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - DecodeEngine
+   ----------------------------------------------------------------------------------------------------*/
+
+// The ways in which a `Video` can decode the frames that are requested from it
+enum class DecodeEngine
+{
+    eSeek,       // Seek to each frame and decode it (which decodes every frame from the previous keyframe onwards)
+    eSequential, // Decode forward through the video, only converting the requested frames to a `Mat`
+    eHybrid,     // Seek or decode forward to each frame, whichever is predicted to be cheaper for this file (see `DecodePlan`)
+    eFastScan,   // Decode keyframes only, without decoding any of the frames in between them (see `FastScanner`)
 };
 
 
 /*----------------------------------------------------------------------------------------------------
     MARK: - Video
       Data and functions relevant to a single video file.
-      Essentially a wrapper class for a cv::VideoCapture object
+      Decoding is done by a `VideoReader`, on top of which `Video` chooses how to reach each frame
    ----------------------------------------------------------------------------------------------------*/
 
 class Video
@@ -70,51 +116,191 @@ class Video
 public:
     Video() {};
     
-    Video(const string& path) : vc{ path }
-    {
-        if (!vc.isOpened())
-            throw FileException("file either could not be opened or is not an accepted format\n", path);
-    }
+    // Throws a FileException if the file could not be opened (see openVideoReader())
+    Video(const string& pathIn, const VideoReaderSettings& settingsIn = {}) : path{ pathIn }, readerSettings{ settingsIn }, reader{ openVideoReader(pathIn, settingsIn) }, index{ reader->isContainerFile() ? ContainerIndex::load(pathIn) : std::make_shared<const ContainerIndex>() }, costModel{ reader->getSeekPreroll() } {}
+
+    // Frames are numbered in presentation order. When the container gives the time of every frame (see `ContainerIndex`), the frame count and
+    // time stamps are taken from it, as the decoder's are estimates (made from the nominal frame rate) that are wrong for variable frame rate video
+    int      getFrameNumber()           const { return requestedFrameNumber >= 0 ? requestedFrameNumber : position; }
+    int      getNumberOfFrames()        const { return index->hasTimestamps() ? index->getNumberOfFrames() : reader->getNumberOfFrames(); }
+    int      getCodec()                 const { return reader->getCodec(); }
+    double   getFPS()                   const { return reader->getFPS(); }
+    cv::Size getDimensions()            const { return reader->getDimensions(); }
+    
+    double   getFrameSeconds(const int frameNumber)   const; // When `frameNumber` is shown, in seconds from the start of the video
+    int      getFrameAtSeconds(const double seconds)   const; // The frame shown at `seconds`
+    double   getDurationSeconds()                      const;
+    
+    VideoBackend       getBackend()     const { return readerSettings.backend; }
+    vector<PacketInfo> getPackets()     const { return reader->getPackets(); } // Empty unless the backend exposes the demuxer's packets
+    
+    void     setFrameNumber(const int num);
+    void     getCurrentFrame(Mat& frameOut);                                              // Overwrite `frameOut` with a `Mat` corresponding to the currently selected frame
+    void     getCurrentFrame(Mat& frameOut, const cv::Size thumbnailSize);                // The same, but shrunk to `thumbnailSize` and in RGB order (see VideoReader::retrieveThumbnail())
+    
+    // Return the frame number of the keyframe closest to `frameNumber`
+    // If the keyframes in the video are unknown (see `ContainerIndex`), `frameNumber` is returned unchanged
+    int      getNearestKeyframe(const int frameNumber) const { return index->getNearestKeyframe(frameNumber); }
+    bool     hasKeyframeIndex()                        const { return index->isValid(); }
+    
+    // The fast scan engine can only decode keyframes, and only when the container describes where each frame is stored
+    void     setDecodeEngine(const DecodeEngine engineIn)    { engine = engineIn; scanner.reset(); plan = DecodePlan{}; }
+    
+    // Once `token` is cancelled, decoding forward stops early and getCurrentFrame() may return an empty frame
+    void     setCancellationToken(const CancellationToken& tokenIn) { token = tokenIn; }
+    
+    // How long decodeFrame() waits for a frame before giving up on it (0 to wait for as long as it takes). Kept by reopen()
+    void     setDecodeTimeout(const int milliseconds)       { decodeTimeout = milliseconds; }
+    
+    // Decode `frameNumber` into `frameOut`, as setFrameNumber() then getCurrentFrame() would, but on the video's `DecodeWorker`, giving up if it
+    // goes longer than the decode timeout without decoding a frame (so long runs of decoding forward aren't given up on). A stuck decoder can't be interrupted: instead it is left to finish on its own (and closed once it
+    // does), giving up its share of the thread budget, and this video carries on with a new decoder and worker. Returns false, with `frameOut`
+    // empty, if the frame was given up on. The frames this video was prepared for should be prepared for again (see prepareFrames())
+    bool     decodeFrame(const int frameNumber, Mat& frameOut, const cv::Size thumbnailSize);
+    
+    // Return the frame number of the first keyframe after `frameNumber`, from the container index or else the demuxer's packets
+    // Returns -1 if there isn't one, or the keyframes are unknown
+    int      getNextKeyframe(const int frameNumber) const;
+    bool     canFastScan()                             const { return FastScanner::canScan(*index); }
+    
+    // Tell the video which frames are about to be requested (in increasing order), so that engines that work on
+    // batches of frames can prepare. Frames that weren't prepared for can still be requested, but may be slower
+    // When the container describes where each frame is stored, the reader is also told which parts of the file will be read (see `ReadAheadFile`)
+    void     prepareFrames(const vector<int>& frameNumbers);
+    
+    // Open a second, independent decoder for the same file, sharing the container index and decode costs rather than remaking them
+    // Throws a FileException if the file can't be opened again
+    Video    reopen() const;
+    
+    // Time a few seeks and a short run of decoding forward, to build the cost model used by DecodeEngine::eHybrid
+    void                   measureDecodeCosts();
+    const DecodeCostModel& getDecodeCostModel() const { return costModel; }
+    
+    // The plan made by the last call to prepareFrames() with DecodeEngine::eHybrid, including how long each part actually took
+    const DecodePlan&      getDecodePlan()      const { return plan; }
 
-    int      getFrameNumber()           const { return vc.get(cv::CAP_PROP_POS_FRAMES);  }
-    int      getNumberOfFrames()        const { return vc.get(cv::CAP_PROP_FRAME_COUNT); }
-    int      getCodec()                 const { return vc.get(cv::CAP_PROP_FOURCC); }
-    double   getFPS()                   const { return vc.get(cv::CAP_PROP_FPS);    }
-    cv::Size getDimensions()            const { return cv::Size(vc.get(cv::CAP_PROP_FRAME_WIDTH),vc.get(cv::CAP_PROP_FRAME_HEIGHT)); }
+private:
+    // A video for the same file with the same settings (see reopen()), but without a reader
+    Video    copySettings() const;
+    
+    // Move forward to `frameNumber` with `grab()`, which decodes each frame without converting or copying it.
+    // If `frameNumber` is behind the current position a seek is unavoidable
+    void     skipToFrame(const int frameNumber);
+    
+    // The reader's own operations, keeping track of `position`
+    void     seekReader(const int frameNumber);
+    bool     grabFrame();
+    void     readFrame(Mat& frameOut, const cv::Size thumbnailSize);
     
-    void     setFrameNumber(const int num)    { vc.set(cv::CAP_PROP_POS_FRAMES, num); }
-    void     getCurrentFrame(Mat& frameOut) { vc.read(frameOut); }                       // Overwrite `frameOut` with a `Mat` corresponding to the currently selected frame
+    // Readers number frames by their time stamp and the nominal frame rate (as OpenCV does), which only counts frames correctly for
+    // constant frame rate video. So seeks are made to the time of the frame, converted to the reader's numbering
+    int      toReaderFrameNumber(const int frameNumber) const;
+    
+    // The parts of the file that decoding `frameNumbers` (in increasing order) reads: for each frame, every sample from the keyframe
+    // before it up to the frame itself, with neighbouring ranges merged. Needs the container to describe where each frame is stored
+    vector<ByteRange> getByteRanges(const vector<int>& frameNumbers) const;
 
 private:
-    cv::VideoCapture vc;
+    string                       path;
+    VideoReaderSettings          readerSettings;
+    VideoReaderPtr               reader               { std::make_shared<OpenCVReader>() };
+    ContainerIndexPtr            index                { std::make_shared<const ContainerIndex>() }; // Shared with every other `Video` for the same file
+    DecodeEngine                 engine               = DecodeEngine::eSeek;
+    std::shared_ptr<FastScanner> scanner;                                                 // Only used by DecodeEngine::eFastScan
+    DecodeCostModel              costModel;
+    DecodePlan                   plan;                                                    // Only used by DecodeEngine::eHybrid
+    CancellationToken            token;
+    int                          requestedFrameNumber = -1;                               // Frame requested with setFrameNumber() but not yet decoded (-1 if none)
+    int                          position             = 0;                                // The next frame that will be decoded
+    int                          decodeTimeout        = 0;                                // See setDecodeTimeout()
+    bool                         seekBeforeNextFrame  = false;                            // Whether the next frame is sought, whatever the engine, as `reader` has just been replaced
+    std::shared_ptr<DecodeWorker> decodeWorker;                                           // Runs decodeFrame(). Started by the first frame decoded with a timeout
 };
 
 
 /*----------------------------------------------------------------------------------------------------
     MARK: - GUIInformation
         For storing and accessing information passed to the backend from the frontend
+        Set by the GUI thread and read by the threads that make the preview, so everything is guarded by `mutex`
    ----------------------------------------------------------------------------------------------------*/
 
 class GUIInformation
 {
 public:
-    int getRows()                { return rowsInPreview; }
-    int getCols()                { return colsInPreview; }
+    int getRows()                { std::lock_guard<std::mutex> lock { mutex }; return rowsInPreview; }
+    int getCols()                { std::lock_guard<std::mutex> lock { mutex }; return colsInPreview; }
+    
+    void setRows(const int rows) { std::lock_guard<std::mutex> lock { mutex }; rowsInPreview = rows; previewIsUpToDate = false; }
+    void setCols(const int cols) { std::lock_guard<std::mutex> lock { mutex }; colsInPreview = cols; previewIsUpToDate = false; }
     
-    void setRows(const int rows) { rowsInPreview = rows; previewIsUpToDate = false; }
-    void setCols(const int cols) { colsInPreview = cols; previewIsUpToDate = false; }
+    // The range of widths (in points) that the "frame_size" option maps onto, and the number of pixels per point on the display
+    void setFrameWidthLimits(const double minWidth, const double maxWidth) { std::lock_guard<std::mutex> lock { mutex }; minFrameWidth = minWidth; maxFrameWidth = maxWidth; }
+    void setDisplayScale(const double scale)                               { std::lock_guard<std::mutex> lock { mutex }; displayScale  = scale; }
     
-    void previewHasBeenUpdated() { previewIsUpToDate = true; }
-    bool isPreviewUpToDate()     { return previewIsUpToDate; }
+    // The width (in pixels) that a frame is displayed at for a given value of the "frame_size" option
+    double getFrameWidthInPixels(const double frameSize) { std::lock_guard<std::mutex> lock { mutex }; return (maxFrameWidth*frameSize + minFrameWidth*(1.0-frameSize)) * displayScale; }
+    
+    // The rows of the preview that are on screen (inclusive), the number of columns they are shown in, and how fast the
+    // preview is scrolling (in rows per second, positive when scrolling down). Read by the threads that extract frames
+    void setViewport(const int firstRow, const int lastRow, const int cols, const double velocity)
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        viewportFirstRow = firstRow;
+        viewportLastRow  = lastRow;
+        viewportCols     = cols;
+        scrollVelocity   = velocity;
+    }
+    
+    // Returns false if the viewport has never been set
+    bool getViewport(int& firstRow, int& lastRow, int& cols, double& velocity)
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        firstRow = viewportFirstRow;
+        lastRow  = viewportLastRow;
+        cols     = viewportCols;
+        velocity = scrollVelocity;
+        return viewportFirstRow >= 0;
+    }
+    
+    // Mark the preview as up to date with the rows and columns, before reading them (so that a change made in between isn't missed)
+    void previewHasBeenUpdated() { std::lock_guard<std::mutex> lock { mutex }; previewIsUpToDate = true; }
+    bool isPreviewUpToDate()     { std::lock_guard<std::mutex> lock { mutex }; return previewIsUpToDate; }
     
 private:
-    int rowsInPreview;
-    int colsInPreview;
+    std::mutex mutex;
+    
+    int rowsInPreview = 0;
+    int colsInPreview = 0;
+    
+    // Defaults match those used by the GUI, in case it never sets them
+    double minFrameWidth = 100.0;
+    double maxFrameWidth = 500.0;
+    double displayScale  = 2.0;
+    
+    int        viewportFirstRow = -1;
+    int        viewportLastRow  = -1;
+    int        viewportCols     = 0;
+    double     scrollVelocity   = 0.0;
     
     bool previewIsUpToDate = true;
 };
 
 
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ZoomLevel
+        A denser preview of the part of the video between two frames (see VideoPreview::zoomIn())
+   ----------------------------------------------------------------------------------------------------*/
+
+struct ZoomLevel
+{
+    int           firstFrameNumber;
+    int           lastFrameNumber;
+    vector<Frame> frames;           // Sorted by frame number, including the frames at both ends of the interval
+};
+
+using ZoomLevelPtr = std::shared_ptr<ZoomLevel>;
+
+
 /*----------------------------------------------------------------------------------------------------
     MARK: - VideoPreview
          The main class associated with previewing a single video. Has three core components:
@@ -123,20 +309,55 @@ private:
               3. `optionsHandler`: a `ConfigOptionsHandler`.    Deals with any options supplied by configuration files
    ----------------------------------------------------------------------------------------------------*/
 
+class FramePrefetcher; // See Prefetch.hpp
+
 class VideoPreview
 {
 public:
     VideoPreview(const string& videoPathIn) : videoPath{ videoPathIn } { }
+    ~VideoPreview();
     
-    // Attempts to initialize video with the file at videoPath
+    // Attempts to initialize video with the file (or image sequence) at videoPath, using the library set by the "video_backend" option
     // Throws a FileException if the file could not be loaded (e.g. invalid file type)
-    void loadVideo()  { video = Video(videoPath); }
+    void loadVideo();
     
     void loadConfig() { optionsHandler = ConfigOptionsHandler{ videoPath }; }
 
     // Everything that needs to be run in order to update the actual video preview that the user sees
     // To be run on start-up and whenever configuration options are changed
+    // Any update that is still running is cancelled first. Frames may still be filled in afterwards if "progressive_preview" is set
     void updatePreview();
+    
+    // The same as updatePreview(), but run on a background thread. Returns a handle for following or cancelling the update
+    // `onComplete` is called (on a background thread) once the update has finished, including if it was cancelled
+    PreviewUpdatePtr updatePreviewAsync(const PreviewUpdate::Callback& onComplete = {});
+    
+    // Cancel the update that is running (if any), and wait for it to stop. Only the frame being decoded on each thread is finished
+    void cancelUpdate();
+    
+    // Select a frame of the video (which needn't be in the preview), and start decoding the frames around it in the background,
+    // as set by the "prefetch_window" option
+    void selectFrame(const int frameNumber);
+    
+    // Move the selection `offset` frames forwards (or backwards, if negative) and return the newly selected frame, at the size the
+    // preview's frames are stored at. Answered from the preview's own frames if it has the frame, and otherwise from the frames decoded by
+    // selectFrame(). Never waits for a frame to be decoded: if it hasn't been yet, it is decoded in the background, and an empty optional
+    // is returned (leaving the selection unchanged), as it is if no frame has been selected or the frame is outside the video
+    std::optional<Frame> stepSelectedFrame(const int offset);
+    
+    // Zoom into the part of the video between two frames (of the preview, or of the current zoom level), returning a preview of just
+    // that interval with as many frames as the preview itself. The frames at either end are included, and any frame that has already
+    // been decoded (by the preview, another zoom level, or around the selected frame) is reused rather than decoded again
+    // Each level is kept, so zooming back out (or into an interval that has been zoomed into before) doesn't decode anything
+    vector<Frame> zoomIn(const Frame& first, const Frame& last) { return zoomIn(first.getFrameNumber(), last.getFrameNumber()); }
+    vector<Frame> zoomIn(const int firstFrameNumber, const int lastFrameNumber);
+    
+    // Go back to the level that was zoomed into before the current one, returning its frames (the preview's frames once fully zoomed out)
+    vector<Frame> zoomOut();
+    
+    // The frames of the current zoom level (the preview's frames if not zoomed in), and how many levels have been zoomed into
+    vector<Frame> getZoomFrames()                  { return zoomStack.empty() ? getFrames() : zoomStack.back()->frames; }
+    size_t        getZoomDepth()                   { return zoomStack.size(); }
 
     // Return a `ConfigOptionPtr` to the config option corresponding to `optionID`.
     // If the option isn't currently set, it is set to the default value as given by ConfigOption::recognisedConfigOptions
@@ -144,28 +365,25 @@ public:
     // It is up to the caller to check if nullptr has been returned
     ConfigOptionPtr getOption(const string& optionID);
     
+    // Setting an option cancels any update that is running and starts a new one with updatePreviewAsync(), so returns straight away
     void setOption(const string& optionID, const bool val)
     {
-        optionsHandler.setOption(optionID, val);
-        updatePreview();
+        setOptionAndUpdate([&]() { optionsHandler.setOption(optionID, val); });
     }
 
     void setOption(const string& optionID, const int val)
     {
-        optionsHandler.setOption(optionID, val);
-        updatePreview();
+        setOptionAndUpdate([&]() { optionsHandler.setOption(optionID, val); });
     }
     
     void setOption(const string& optionID, const double val)
     {
-        optionsHandler.setOption(optionID, val);
-        updatePreview();
+        setOptionAndUpdate([&]() { optionsHandler.setOption(optionID, val); });
     }
 
     void setOption(const string& optionID, const string val)
     {
-        optionsHandler.setOption(optionID, val);
-        updatePreview();
+        setOptionAndUpdate([&]() { optionsHandler.setOption(optionID, val); });
     }
     
     void setOption(const string& optionID, const char* val)
@@ -176,21 +394,25 @@ public:
     // Save a set of current configuration options to either 1) a preexisiting configuration file, or 2) an arbitrary new file
     // In the case of 1, the formatting of the file is maintained, but any options that have been changed are overwritten
     // Function overrides allow the file to be passed as either a string, or a ConfigFilePtr
-    void saveOptions(ConfigOptionVector options, const ConfigFilePtr& file) { optionsHandler.saveOptions(options, file); }
+    void saveOptions(ConfigOptionVector options, const ConfigFilePtr& file) { std::lock_guard<std::recursive_mutex> lock { optionsMutex }; optionsHandler.saveOptions(options, file); }
     void saveOptions(ConfigOptionVector options, const string& filePath);
     
-    void saveAllOptions(const ConfigFilePtr& file)                          { optionsHandler.saveAllOptions(file); }
-    void saveAllOptions(const string& filePath)                             { saveOptions(optionsHandler.getOptions(), filePath); }
+    void saveAllOptions(const ConfigFilePtr& file)                          { std::lock_guard<std::recursive_mutex> lock { optionsMutex }; optionsHandler.saveAllOptions(file); }
+    void saveAllOptions(const string& filePath)                             { std::lock_guard<std::recursive_mutex> lock { optionsMutex }; saveOptions(optionsHandler.getOptions(), filePath); }
     
-    void saveOption(ConfigOptionPtr option, const ConfigFilePtr& file)      { optionsHandler.saveOptions(ConfigOptionVector{option}, file); }
+    void saveOption(ConfigOptionPtr option, const ConfigFilePtr& file)      { saveOptions(ConfigOptionVector{option}, file); }
     void saveOption(ConfigOptionPtr option, const string& filePath)         { saveOptions(ConfigOptionVector{option}, filePath); }
 
     void printConfig() const
     {
+        std::lock_guard<std::recursive_mutex> lock { optionsMutex };
         cout << "Current configuration options:\n";
         optionsHandler.print();
     }
     
+    // The plan used to decode the frames decoded most recently, by the preview or a zoom level (empty unless the hybrid decode engine was used on a single thread)
+    DecodePlan    getDecodePlan()                  { std::lock_guard<std::mutex> lock { framesMutex }; return decodePlan; }
+    
     string getVideoPathString()        { return videoPath; }
     string getVideoNumOfFramesString() { return std::to_string(video.getNumberOfFrames()); }
     
@@ -216,7 +438,7 @@ public:
     
     string getVideoLengthString()
     {
-        int    seconds = frameNumberToSeconds(video.getNumberOfFrames(), video.getFPS());
+        int    seconds = video.getDurationSeconds();
         return secondsToTimeStamp(seconds);
     }
     
@@ -238,6 +460,8 @@ public:
     
     vector<string> getConfigFilePaths()
     {
+        std::lock_guard<std::recursive_mutex> lock { optionsMutex };
+        
         vector<ConfigFilePtr> files = optionsHandler.getConfigFiles();
         vector<string> filePaths;
         filePaths.reserve(files.size());
@@ -246,18 +470,119 @@ public:
         return filePaths;
     }
     
-    vector<Frame> getFrames()                      { return frames; }
-    size_t        getNumOfFrames()                 { return frames.size(); }
+    // The frames may be changed by a background thread while the "progressive_preview" option is set (see makeFrames())
+    vector<Frame> getFrames()                      { std::lock_guard<std::mutex> lock { framesMutex }; return frames; }
+    size_t        getNumOfFrames()                 { std::lock_guard<std::mutex> lock { framesMutex }; return frames.size(); }
+    unsigned long getFramesVersion()               { std::lock_guard<std::mutex> lock { framesMutex }; return framesVersion; } // Changes every time the `frames` vector is remade
+    
+    // The fraction of the frames in the preview that have been decoded at their final position and size (1 once the preview is complete)
+    double        getCompleteness()                { std::lock_guard<std::mutex> lock { framesMutex }; return completeness; }
+    
+    // How many frames in the current preview were reused from the previous preview, and how many had to be decoded
+    size_t        getNumOfReusedFrames()           { std::lock_guard<std::mutex> lock { framesMutex }; return reusedFrameCount; }
+    size_t        getNumOfDecodedFrames()          { std::lock_guard<std::mutex> lock { framesMutex }; return decodedFrameCount; }
+    
+    // The frames in the current preview that took longer than the "decode_timeout_ms" option to decode, which show a later keyframe or nothing instead
+    vector<int>   getSkippedFrameNumbers()
+    {
+        std::lock_guard<std::mutex> lock { framesMutex };
+        vector<int> frameNumbers;
+        for (const Frame& frame : frames)
+            if (frame.isSubstitute() || frame.isSkipped())
+                frameNumbers.push_back(frame.getFrameNumber());
+        return frameNumbers;
+    }
+    
+    // How many frames in the current preview haven't been decoded yet (e.g. because the "time_budget_ms" option ran out, and they're still being decoded)
+    size_t        getNumOfPendingFrames()          { std::lock_guard<std::mutex> lock { framesMutex }; return pendingFrameCount; }
+    
+    // How long (in milliseconds) the last preview made under the "time_budget_ms" option took, out of the budget (0 if no budget was set)
+    long long     getTimeBudgetUsed()              { std::lock_guard<std::mutex> lock { framesMutex }; return timeBudgetUsed; }
     
     void          setRowsInPreview(const int rows) { guiInfo.setRows(rows); }
     void          setColsInPreview(const int cols) { guiInfo.setCols(cols); }
     int           getRowsInPreview()               { return guiInfo.getRows(); }
     int           getColsInPreview()               { return guiInfo.getCols(); }
     
+    void          setFrameWidthLimits(const double minWidth, const double maxWidth) { guiInfo.setFrameWidthLimits(minWidth, maxWidth); }
+    void          setDisplayScale(const double scale)                               { guiInfo.setDisplayScale(scale); }
+    void          setViewport(const int firstRow, const int lastRow, const int cols, const double velocity) { guiInfo.setViewport(firstRow, lastRow, cols, velocity); }
+    
+    // The width (in pixels) that frames are currently shown at, as set by the "frame_size" option
+    int           getDisplayedFrameWidth()         { return static_cast<int>(std::ceil(guiInfo.getFrameWidthInPixels(getOption("frame_size")->getValue()->getDouble().value()))); }
+    
 private:
+    // The body of updatePreview(), run as part of `update`
+    void runUpdate(const PreviewUpdatePtr& update);
+    
+    // Cancel any update, make a change to the options (while no other thread can read them), then start a new update in the background
+    void setOptionAndUpdate(const std::function<void()>& changeOption);
+    
+    // Open a new decoder for the video (see Video::reopen()), with the time limit set by the "decode_timeout_ms" option
+    // Throws a FileException if the file can't be opened again
+    Video openDecoder();
+    
     // Read in appropriate configuration options and write over the `frames` vector
-    void makeFrames();
+    // If the "progressive_preview" option is set, a coarse preview is published first and the frames are then decoded by `refineThread`
+    // If the "time_budget_ms" option is set, it takes precedence: the frames decoded within the budget are published as they are decoded (see
+    // extractWithinBudget()), and the rest are then decoded by `refineThread`
+    void makeFrames(const PreviewUpdatePtr& update);
+    
+    // The decoders extractFramesInParallel() decodes each segment with, one per thread, opened (from the main decoder) the first time a
+    // thread needs one. Kept for the whole of an update, so that each batch or pass reuses them rather than opening decoders of its own
+    using SegmentDecoders = vector<std::optional<Video>>;
+    
+    // Decode each pass of frames with `decoder` and publish them, until all passes are done or `update` is cancelled. Run on `refineThread`
+    void refineFrames(Video decoder, const vector<vector<int>> passes, const DecodeEngine engine, const cv::Size thumbnailSize, const PreviewUpdatePtr update);
+    
+    // Decode `frameNumbers` with `decoder` in batches, publishing each batch as soon as it has been decoded
+    // Each batch is chosen just before it is decoded, so that the frames nearest the part of the preview on screen at the time come first
+    void extractInViewportOrder(Video& decoder, SegmentDecoders& segmentDecoders, vector<int> frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, PreviewUpdate& update);
+    
+    // Decode `framesToDecode` with `decoder`, publishing the frames that cover the preview most evenly first, until the "time_budget_ms" option's
+    // `budget` (counted from `startTime`) runs out. `update` should already have its deadline set (see makeFrames())
+    void extractWithinBudget(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& framesToDecode, const DecodeEngine engine, const cv::Size thumbnailSize, const std::chrono::steady_clock::time_point startTime, const int budget, PreviewUpdate& update);
+    
+    // Remove the frames that should be decoded next from `frameNumbers`, and return them in increasing order (see extractInViewportOrder())
+    vector<int> takeNextBatch(vector<int>& frameNumbers);
+    
+    // Add `newFrames` to `frameStore`, then remake `frames` from every frame in `targetFrameNumbers` that has been decoded plus `placeholderFrames`
+    void publishFrames(const vector<Frame>& newFrames, const vector<Frame>& placeholderFrames = {});
+    
+    // Decode `frameNumbers` with `decoder` (on `NThreads` threads, using `segmentDecoders` as well), logging how long it took
+    // Stops early (returning only the frames decoded so far) if `update` is cancelled
+    vector<Frame> extractFrames(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, const int NThreads, PreviewUpdate& update);
+    
+    // Determine the frame numbers to sample for a preview with `NFrames` frames, taking into account the "sampling_mode" and "sampling_schedule" options
+    // The returned frame numbers are sorted and unique, so there may be fewer than `NFrames` of them
+    // With the "nested" schedule, the frames sampled for N frames are (before any snapping to keyframes) also sampled for N+1, 2N, ...
+    vector<int> getSampleFrameNumbers(const int NFrames);
+    
+    // Determine how to open the video, taking into account the "video_backend" and "default_fps" options
+    VideoReaderSettings chooseReaderSettings();
+    
+    // Determine which `DecodeEngine` to extract frames with, taking into account the "decode_engine" option
+    DecodeEngine chooseDecodeEngine();
+    
+    // Determine the size that frames are stored at, taking into account the "thumbnail_width" option
+    // Frames are shrunk to this size as soon as they are decoded, but are never enlarged. By default this is the size of the largest
+    // frames the GUI can show, so that changing "frame_size" only ever needs a different level of each frame's pyramid
+    cv::Size chooseThumbnailSize();
+    
+    // Determine how many threads to extract `NFrames` frames with, taking into account the "extraction_threads" option
+    int chooseExtractionThreads(const int NFrames);
+    
+    // Split `frameNumbers` into `NThreads` contiguous segments of the video and decode each segment on its own thread, with its own decoder
+    // from `segmentDecoders` (opened from `decoder` if the thread doesn't have one yet). The returned frames are in the same order as `frameNumbers`
+    vector<Frame> extractFramesInParallel(Video& decoder, SegmentDecoders& segmentDecoders, const vector<int>& frameNumbers, const DecodeEngine engine, const cv::Size thumbnailSize, const int NThreads, PreviewUpdate& update);
 
+    // Determine the frames for a zoom level from `firstFrameNumber` to `lastFrameNumber` (inclusive) with `NFrames` frames
+    // The frames are evenly spaced, and include both ends of the interval. Sorted and unique, so there may be fewer than `NFrames`
+    static vector<int> getIntervalFrameNumbers(const int firstFrameNumber, const int lastFrameNumber, const int NFrames);
+    
+    // Return `frameNumber` from `frameStore` if it has been decoded (at `framesSize`). Safe to call while an update is running
+    std::optional<Frame> getStoredFrame(const int frameNumber);
+    
     // Determine if a given configuration option has been changed since the last time the preview was updated
     // Achieved by comparing the relevant `ConfigOptionPtr`s in `currentPreviewConfigOptions` and `optionsHandler`
     bool configOptionHasBeenChanged(const string& optionID);
@@ -266,10 +591,32 @@ private:
     string               videoPath;                   // Path to the video file
     string               videoDir;                    // Path to the directory containing the video file
     string               exportDir;                   // Path to the directory for exporting temporary files to
-    Video                video;
+    Video                video;                       // Only changed by loadVideo(), so that any thread can read it. Frames are decoded by other `Video`s (see openDecoder())
+    std::optional<Video> previewDecoder;              // Decodes the frames of the preview, on the thread running the update. Opened by the first update
     ConfigOptionsHandler optionsHandler;
     ConfigOptionVector   currentPreviewConfigOptions; // The configuration options corresponding to the current preview (even if internal options have been changed)
     vector<Frame>        frames;                      // Vector of each Frame in the preview
+    unsigned long        framesVersion = 0;           // Incremented every time `frames` is remade
+    cv::Size             framesSize;                  // The size that the frames in `frames` are stored at
+    std::map<int, Frame> frameStore;                  // Every decoded frame that is being kept (including those in `frames`), keyed by frame number
+    vector<int>          targetFrameNumbers;          // The frames that the preview will show once it is complete
+    double               completeness = 1.0;          // See getCompleteness()
+    size_t               pendingFrameCount = 0;       // See getNumOfPendingFrames()
+    std::mutex           framesMutex;                 // Guards everything above (read by the GUI thread while updates run), and the counts and plan below
+    std::thread          refineThread;                // Decodes frames in the background (see makeFrames())
+    std::thread          updateThread;                // Runs updates started by updatePreviewAsync()
+    PreviewUpdatePtr     currentUpdate;               // The most recent update (which may have finished)
+    mutable std::recursive_mutex optionsMutex;        // Guards `optionsHandler`, which is read by `updateThread` and changed by the caller
+    size_t               reusedFrameCount  = 0;       // See getNumOfReusedFrames()
+    size_t               decodedFrameCount = 0;       // See getNumOfDecodedFrames()
+    long long            timeBudgetUsed    = 0;       // See getTimeBudgetUsed()
+    DecodePlan           decodePlan;                  // See getDecodePlan()
+    std::unique_ptr<FramePrefetcher> prefetcher;      // Decodes the frames around the selected frame. Only made once a frame is selected
+    int                  selectedFrameNumber = -1;    // -1 if no frame has been selected
+    std::optional<Video> zoomDecoder;                 // Decodes the frames of every zoom level, so that each level carries on from where the last left off
+    vector<ZoomLevelPtr> zoomStack;                   // The levels that have been zoomed into, outermost first
+    std::map<std::pair<int,int>, ZoomLevelPtr> zoomCache; // Every zoom level that has been made, keyed by the frame numbers at either end
+    cv::Size             zoomCacheSize;               // The size of the frames in `zoomCache`
     GUIInformation       guiInfo;
 };
 
@@ -0,0 +1,113 @@
+#ifndef PreviewUpdate_hpp
+#define PreviewUpdate_hpp
+
+#include <atomic>             // for std::atomic
+#include <chrono>             // for std::chrono::steady_clock
+#include <condition_variable> // for std::condition_variable
+#include <functional>         // for std::function
+#include <limits>             // for std::numeric_limits
+#include <memory>             // for std::shared_ptr
+#include <mutex>              // for std::mutex
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - CancellationToken
+        Shared between whoever may want to cancel some work and the code doing it, which is expected to
+        check `isCancelled()` regularly (e.g. between frames) and stop early. Copies of a token share the
+        same state, so a token can be handed to several threads.
+
+        A token can also be given a deadline, after which it counts as cancelled without anyone having
+        to cancel it.
+   ----------------------------------------------------------------------------------------------------*/
+
+class CancellationToken
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void cancel()                                   { cancelled->store(true); }
+    bool isCancelled() const                        { return cancelled->load() || isPastDeadline(); }
+
+    void setDeadline(const Clock::time_point time)  { deadline->store(time.time_since_epoch().count()); }
+    bool isPastDeadline() const                     { return Clock::now().time_since_epoch().count() >= deadline->load(); }
+
+private:
+    std::shared_ptr<std::atomic<bool>>        cancelled { std::make_shared<std::atomic<bool>>(false) };
+    std::shared_ptr<std::atomic<Clock::rep>>  deadline  { std::make_shared<std::atomic<Clock::rep>>(std::numeric_limits<Clock::rep>::max()) };
+};
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - PreviewUpdate
+        A handle to an update of a `VideoPreview` (see `VideoPreview::updatePreviewAsync()`), which may
+        still be running on other threads.
+
+        An update can be made up of several tasks (e.g. making a coarse preview, then refining it in the
+        background). It is finished once every task that was added has been done, at which point the
+        completion callback is called on the thread that did the last task.
+   ----------------------------------------------------------------------------------------------------*/
+
+class PreviewUpdate
+{
+public:
+    using Callback = std::function<void(const PreviewUpdate&)>;
+
+    PreviewUpdate(const Callback& onCompleteIn = {}) : onComplete{ onCompleteIn } {}
+
+    // Ask the update to stop as soon as it can. The completion callback is still called once it has stopped
+    void   cancel()            { token.cancel(); }
+    bool   isCancelled() const { return token.isCancelled(); }
+    bool   isFinished()  const { return finished.load(); }
+
+    // Stop the update (as if it were cancelled) once `time` has passed
+    void   setDeadline(const CancellationToken::Clock::time_point time) { token.setDeadline(time); }
+    bool   isPastDeadline() const                                       { return token.isPastDeadline(); }
+
+    // The fraction of the frames to be decoded by the update that have been decoded so far (1 if there are none)
+    double getProgress() const
+    {
+        size_t total = framesToDecode.load();
+        return total == 0 ? 1.0 : static_cast<double>(framesDecoded.load()) / total;
+    }
+
+    // Block until the update has finished
+    void   wait()
+    {
+        std::unique_lock<std::mutex> lock { finishedMutex };
+        finishedCondition.wait(lock, [this]() { return finished.load(); });
+    }
+
+    const CancellationToken& getCancellationToken() const { return token; }
+
+    // For the code doing the update
+    void   addTask()                             { ++pendingTasks; }
+    void   addFramesToDecode(const size_t count) { framesToDecode += count; }
+    void   frameDecoded()                        { ++framesDecoded; }
+    void   taskDone()
+    {
+        if (--pendingTasks > 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock { finishedMutex };
+            finished = true;
+        }
+        finishedCondition.notify_all();
+
+        if (onComplete)
+            onComplete(*this);
+    }
+
+private:
+    CancellationToken       token;
+    Callback                onComplete;
+    std::atomic<int>        pendingTasks   { 0 };
+    std::atomic<size_t>     framesToDecode { 0 };
+    std::atomic<size_t>     framesDecoded  { 0 };
+    std::atomic<bool>       finished       { false };
+    std::mutex              finishedMutex;
+    std::condition_variable finishedCondition;
+};
+
+using PreviewUpdatePtr = std::shared_ptr<PreviewUpdate>;
+
+#endif /* PreviewUpdate_hpp */
@@ -0,0 +1,348 @@
+#include "RawYUVReader.hpp"
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/imgproc.hpp>   // for cv::resize() and cv::cvtColor()
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <algorithm>  // for std::max(), std::min() and std::transform()
+#include <cctype>     // for tolower()
+#include <cstring>    // for std::memchr() and std::memcmp()
+#include <filesystem> // for std::filesystem::path
+#include <regex>      // for std::regex
+#include <sstream>    // for std::istringstream
+
+#include <fcntl.h>    // for open()
+#include <sys/mman.h> // for mmap()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for close()
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - RawYUVReader
+   ----------------------------------------------------------------------------------------------------*/
+
+static const string y4mSignature        { "YUV4MPEG2 " };
+static const string y4mFrameSignature   { "FRAME" };
+static const size_t maxY4MHeaderBytes   = 4096; // Generous; real stream headers are a few dozen bytes
+static const size_t maxFrameHeaderBytes = 256;
+
+RawYUVReader::RawYUVReader(const string& filePath, const double defaultFPS)
+{
+    int file = open(filePath.c_str(), O_RDONLY);
+    if (file < 0)
+        return; // isOpened() is false
+
+    struct stat fileInfo;
+    if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0)
+    {
+        close(file);
+        return;
+    }
+
+    void* data = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // The mapping stays valid after the file is closed
+
+    if (data == MAP_FAILED)
+        return;
+
+    mapping      = static_cast<const uchar*>(data);
+    mappingBytes = static_cast<size_t>(fileInfo.st_size);
+
+    try
+    {
+        string extension { std::filesystem::path(filePath).extension().string() };
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        if (extension == ".y4m")
+            parseY4MHeader(filePath, defaultFPS);
+        else
+            parseRawName(filePath, defaultFPS);
+
+        if (numberOfFrames == 0)
+            throw FileException("file does not contain a whole frame\n", filePath);
+    }
+    catch (...)
+    {
+        munmap(const_cast<uchar*>(mapping), mappingBytes); // The destructor isn't run for a constructor that throws
+        throw;
+    }
+}
+
+RawYUVReader::~RawYUVReader()
+{
+    if (mapping)
+        munmap(const_cast<uchar*>(mapping), mappingBytes);
+}
+
+bool RawYUVReader::isRawYUVPath(const string& filePath)
+{
+    const static std::regex rawExtension { "\\.(y4m|yuv)$", std::regex::icase };
+    return std::regex_search(filePath, rawExtension);
+}
+
+bool RawYUVReader::grab()
+{
+    if (position < 0 || position >= numberOfFrames)
+    {
+        decodedFrame = -1;
+        return false;
+    }
+
+    decodedFrame = position++;
+    adviseUpcomingFrames(1);
+    return true;
+}
+
+bool RawYUVReader::retrieve(Mat& frameOut)
+{
+    if (decodedFrame < 0)
+        return false;
+
+    convertFrame(frameOut, dimensions, false);
+    return true;
+}
+
+bool RawYUVReader::retrieveThumbnail(Mat& thumbnailOut, const cv::Size thumbnailSize)
+{
+    if (decodedFrame < 0)
+        return false;
+
+    convertFrame(thumbnailOut, thumbnailSize.empty() ? dimensions : thumbnailSize, true);
+    return true;
+}
+
+void RawYUVReader::prepareFrames(const vector<int>& frameNumbers)
+{
+    upcomingFrames    = frameNumbers;
+    nextUpcomingFrame = 0;
+    adviseUpcomingFrames(framesToAdvise);
+}
+
+void RawYUVReader::parseY4MHeader(const string& filePath, const double defaultFPS)
+{
+    const char* data = reinterpret_cast<const char*>(mapping);
+
+    if (mappingBytes < y4mSignature.size() || std::memcmp(data, y4mSignature.data(), y4mSignature.size()) != 0)
+        throw FileException("file is not a YUV4MPEG2 file\n", filePath);
+
+    const char* headerEnd = static_cast<const char*>(std::memchr(data, '\n', std::min(mappingBytes, maxY4MHeaderBytes)));
+    if (!headerEnd)
+        throw FileException("YUV4MPEG2 stream header is not terminated\n", filePath);
+
+    // The header is a list of space separated parameters, each a letter followed by its value
+    std::istringstream header { string(data + y4mSignature.size(), headerEnd) };
+    string             parameter;
+    string             colourSpace { "420" }; // The default, when no colour space is given
+    fps = defaultFPS;
+
+    try
+    {
+        while (header >> parameter)
+        {
+            string value { parameter.substr(1) };
+            switch (parameter[0])
+            {
+                case 'W': dimensions.width  = std::stoi(value); break;
+                case 'H': dimensions.height = std::stoi(value); break;
+                case 'C': colourSpace       = value;            break;
+                case 'F':
+                {
+                    size_t separator   = value.find(':');
+                    double numerator   = std::stod(value.substr(0, separator));
+                    double denominator = separator == string::npos ? 1.0 : std::stod(value.substr(separator + 1));
+                    if (numerator > 0 && denominator > 0)
+                        fps = numerator / denominator;
+                    break;
+                }
+                default: break; // Interlacing, pixel aspect ratio and extensions don't affect how the frames are read
+            }
+        }
+    }
+    catch (const std::logic_error&) // From std::stoi() or std::stod()
+    {
+        throw FileException("YUV4MPEG2 stream header could not be understood\n", filePath);
+    }
+
+    if (dimensions.width <= 0 || dimensions.height <= 0)
+        throw FileException("YUV4MPEG2 stream header does not give the frame dimensions\n", filePath);
+
+    if      (colourSpace.rfind("420", 0) == 0 && colourSpace.find('p') == string::npos) chromaFormat = ChromaFormat::e420; // "420jpeg", "420paldv", "420mpeg2", but not "420p10"
+    else if (colourSpace == "422")                                                      chromaFormat = ChromaFormat::e422;
+    else if (colourSpace == "444")                                                      chromaFormat = ChromaFormat::e444;
+    else if (colourSpace == "mono")                                                     chromaFormat = ChromaFormat::eMono;
+    else
+        throw FileException("YUV4MPEG2 colour space \"" + colourSpace + "\" is not supported (only 8-bit 4:2:0, 4:2:2, 4:4:4 and mono are)\n", filePath);
+
+    // Each frame is a "FRAME" header (normally with no parameters) followed by its samples. Assume every header is the same length as the first,
+    // so each frame's offset can be calculated, and check that assumption against the last frame
+    size_t firstHeader = headerEnd - data + 1;
+    if (mappingBytes - firstHeader < y4mFrameSignature.size() || std::memcmp(mapping + firstHeader, y4mFrameSignature.data(), y4mFrameSignature.size()) != 0)
+        throw FileException("YUV4MPEG2 file has no frames\n", filePath);
+
+    const void* firstHeaderEnd = std::memchr(mapping + firstHeader, '\n', std::min(mappingBytes - firstHeader, maxFrameHeaderBytes));
+    if (!firstHeaderEnd)
+        throw FileException("YUV4MPEG2 frame header is not terminated\n", filePath);
+
+    size_t headerBytes = static_cast<const uchar*>(firstHeaderEnd) - (mapping + firstHeader) + 1;
+    firstFrameOffset   = firstHeader + headerBytes;
+    frameStride        = headerBytes + getFrameBytes();
+    numberOfFrames     = static_cast<int>((mappingBytes - firstHeader) / frameStride);
+
+    size_t lastHeader = firstHeader + (numberOfFrames - 1) * frameStride;
+    if (numberOfFrames > 0 && std::memcmp(mapping + lastHeader, y4mFrameSignature.data(), y4mFrameSignature.size()) == 0 && mapping[lastHeader + headerBytes - 1] == '\n')
+        return;
+
+    // The headers differ in length, so walk through them all to find each frame (this touches every frame, so is only done when necessary)
+    for (size_t nextHeader = firstHeader; mappingBytes - nextHeader >= y4mFrameSignature.size(); )
+    {
+        if (std::memcmp(mapping + nextHeader, y4mFrameSignature.data(), y4mFrameSignature.size()) != 0)
+            break;
+
+        const void* headerEnd = std::memchr(mapping + nextHeader, '\n', std::min(mappingBytes - nextHeader, maxFrameHeaderBytes));
+        if (!headerEnd)
+            break;
+
+        size_t frameOffset = static_cast<const uchar*>(headerEnd) - mapping + 1;
+        if (mappingBytes - frameOffset < getFrameBytes())
+            break; // A truncated last frame
+
+        frameOffsets.push_back(frameOffset);
+        nextHeader = frameOffset + getFrameBytes();
+    }
+
+    numberOfFrames = static_cast<int>(frameOffsets.size());
+}
+
+void RawYUVReader::parseRawName(const string& filePath, const double defaultFPS)
+{
+    const static std::regex dimensionsInName { "([0-9]+)x([0-9]+)" };
+
+    string      name { std::filesystem::path(filePath).filename().string() };
+    std::smatch match;
+    if (!std::regex_search(name, match, dimensionsInName))
+        throw FileException("raw YUV file names must include the frame dimensions (e.g. \"video_1920x1080.yuv\")\n", filePath);
+
+    try
+    {
+        dimensions = cv::Size{ std::stoi(match[1]), std::stoi(match[2]) };
+    }
+    catch (const std::logic_error&) // From std::stoi(), when a dimension doesn't fit in an int
+    {
+        throw FileException("raw YUV file name gives frame dimensions that are too large\n", filePath);
+    }
+
+    chromaFormat = ChromaFormat::e420;
+    fps          = defaultFPS;
+
+    if (dimensions.width <= 0 || dimensions.height <= 0)
+        throw FileException("raw YUV file name gives empty frame dimensions\n", filePath);
+
+    firstFrameOffset = 0;
+    frameStride      = getFrameBytes();
+    numberOfFrames   = static_cast<int>(mappingBytes / frameStride);
+}
+
+size_t RawYUVReader::getFrameOffset(const int frameNumber) const
+{
+    return frameOffsets.empty() ? firstFrameOffset + frameNumber * frameStride : frameOffsets[frameNumber];
+}
+
+cv::Size RawYUVReader::getChromaSize() const
+{
+    switch (chromaFormat)
+    {
+        case ChromaFormat::e420:  return { (dimensions.width + 1) / 2, (dimensions.height + 1) / 2 };
+        case ChromaFormat::e422:  return { (dimensions.width + 1) / 2, dimensions.height };
+        case ChromaFormat::e444:  return dimensions;
+        case ChromaFormat::eMono: return { 0, 0 };
+    }
+    return { 0, 0 };
+}
+
+size_t RawYUVReader::getFrameBytes() const
+{
+    return static_cast<size_t>(dimensions.area()) + 2 * static_cast<size_t>(getChromaSize().area());
+}
+
+void RawYUVReader::convertFrame(Mat& frameOut, const cv::Size outputSize, const bool rgbOrder)
+{
+    const int fromGrey = rgbOrder ? cv::COLOR_GRAY2RGB     : cv::COLOR_GRAY2BGR;
+    const int fromI420 = rgbOrder ? cv::COLOR_YUV2RGB_I420 : cv::COLOR_YUV2BGR_I420;
+
+    // These headers point straight into the (read only) mapping, and are only ever read from
+    uchar* frame = const_cast<uchar*>(getFrameData(decodedFrame));
+    Mat    luma  { dimensions, CV_8UC1, frame };
+
+    if (chromaFormat == ChromaFormat::eMono)
+    {
+        if (outputSize == dimensions)
+            cv::cvtColor(luma, frameOut, fromGrey);
+        else
+        {
+            cv::resize(luma, i420, outputSize, 0, 0, cv::INTER_AREA);
+            cv::cvtColor(i420, frameOut, fromGrey);
+        }
+        return;
+    }
+
+    // At full size, a 4:2:0 frame is already laid out as I420, so can be converted without copying it first
+    bool evenDimensions = dimensions.width % 2 == 0 && dimensions.height % 2 == 0;
+    if (chromaFormat == ChromaFormat::e420 && evenDimensions && outputSize == dimensions)
+    {
+        cv::cvtColor(Mat(dimensions.height * 3 / 2, dimensions.width, CV_8UC1, frame), frameOut, fromI420);
+        return;
+    }
+
+    // Otherwise shrink each plane into an I420 frame at `outputSize` (rounded down to even dimensions, which I420 needs), and convert that
+    cv::Size chromaSize { getChromaSize() };
+    Mat      u          { chromaSize, CV_8UC1, frame + luma.total() };
+    Mat      v          { chromaSize, CV_8UC1, frame + luma.total() + u.total() };
+
+    cv::Size evenSize   { std::max(2, outputSize.width & ~1), std::max(2, outputSize.height & ~1) };
+    cv::Size halfSize   { evenSize.width / 2, evenSize.height / 2 };
+
+    i420.create(evenSize.height * 3 / 2, evenSize.width, CV_8UC1);
+    Mat      lumaOut    { evenSize, CV_8UC1, i420.data };
+    Mat      uOut       { halfSize, CV_8UC1, lumaOut.data + lumaOut.total() };
+    Mat      vOut       { halfSize, CV_8UC1, uOut.data + uOut.total() };
+
+    cv::resize(luma, lumaOut, evenSize, 0, 0, cv::INTER_AREA);
+    cv::resize(u,    uOut,    halfSize, 0, 0, cv::INTER_AREA);
+    cv::resize(v,    vOut,    halfSize, 0, 0, cv::INTER_AREA);
+
+    if (evenSize == outputSize)
+        cv::cvtColor(i420, frameOut, fromI420);
+    else
+    {
+        Mat evenFrame;
+        cv::cvtColor(i420, evenFrame, fromI420);
+        cv::resize(evenFrame, frameOut, outputSize, 0, 0, cv::INTER_LINEAR);
+    }
+}
+
+void RawYUVReader::adviseUpcomingFrames(const int count)
+{
+    const static size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    for (int advised = 0; advised < count && nextUpcomingFrame < upcomingFrames.size(); )
+    {
+        int frameNumber = upcomingFrames[nextUpcomingFrame++];
+        if (frameNumber <= decodedFrame || frameNumber >= numberOfFrames)
+            continue;
+
+        size_t frameStart = getFrameOffset(frameNumber);
+        size_t pageStart  = frameStart / pageSize * pageSize; // madvise() needs a page aligned address
+        madvise(const_cast<uchar*>(mapping) + pageStart, frameStart + getFrameBytes() - pageStart, MADV_WILLNEED);
+        ++advised;
+    }
+}
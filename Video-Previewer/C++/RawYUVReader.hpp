@@ -0,0 +1,97 @@
+#ifndef RawYUVReader_hpp
+#define RawYUVReader_hpp
+
+#include "VideoReader.hpp"
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - RawYUVReader
+        A `VideoReader` for uncompressed 8-bit YUV video: YUV4MPEG2 (".y4m") files, or headerless planar
+        4:2:0 (".yuv") files with their dimensions in the file name (e.g. "foreman_352x288.yuv").
+
+        The file is memory mapped rather than read, and every frame lies at a known offset in it, so
+        seeking is free and nothing is copied until a frame is converted to BGR: the planes are wrapped
+        as `Mat` headers pointing into the mapping, and thumbnails are shrunk from them directly (the
+        chroma planes being a quarter of the size of the frame, shrinking before converting is cheaper
+        than converting the full frame).
+
+        Y4M files may be 4:2:0 (any chroma siting), 4:2:2, 4:4:4 or monochrome. Files with more than
+        8 bits per sample, or an alpha plane, aren't supported.
+   ----------------------------------------------------------------------------------------------------*/
+
+class RawYUVReader : public VideoReader
+{
+public:
+    // Throws a FileException if the file isn't laid out as described above. `defaultFPS` is used for .yuv files, which don't record a frame rate
+    RawYUVReader(const string& filePath, const double defaultFPS);
+    ~RawYUVReader();
+
+    RawYUVReader(const RawYUVReader&)            = delete; // Each reader owns its mapping
+    RawYUVReader& operator=(const RawYUVReader&) = delete;
+
+    // Whether `filePath` ends in ".y4m" or ".yuv"
+    static bool isRawYUVPath(const string& filePath);
+
+    bool     isOpened()          const override { return mapping != nullptr; }
+    int      getPosition()       const override { return position; }
+    int      getNumberOfFrames() const override { return numberOfFrames; }
+    int      getCodec()          const override { return cv::VideoWriter::fourcc('I', '4', '2', '0'); }
+    double   getFPS()            const override { return fps; }
+    cv::Size getDimensions()     const override { return dimensions; }
+
+    void     seek(const int frameNumber) override { position = frameNumber; decodedFrame = -1; }
+    bool     grab()                      override;
+    bool     retrieve(Mat& frameOut)     override;
+    bool     retrieveThumbnail(Mat& thumbnailOut, const cv::Size thumbnailSize) override;
+
+    bool     isContainerFile()   const override { return false; }
+    void     prepareFrames(const vector<int>& frameNumbers) override;
+
+private:
+    enum class ChromaFormat
+    {
+        e420,
+        e422,
+        e444,
+        eMono,
+    };
+
+    // Read the stream header of a Y4M file, and find where its frames are. Throws a FileException if the header can't be understood
+    void           parseY4MHeader(const string& filePath, const double defaultFPS);
+
+    // Take the dimensions of a .yuv file from its name, and find where its frames are. Throws a FileException if there are none in the name
+    void           parseRawName(const string& filePath, const double defaultFPS);
+
+    size_t         getFrameOffset(const int frameNumber) const;
+    const uchar*   getFrameData(const int frameNumber)   const { return mapping + getFrameOffset(frameNumber); }
+    cv::Size       getChromaSize()                       const;
+    size_t         getFrameBytes()                       const;
+
+    // Convert the frame decoded by the last call to grab() to BGR (or RGB, if `rgbOrder`) at `outputSize`, shrinking the planes first if it's
+    // smaller than the frame
+    void           convertFrame(Mat& frameOut, const cv::Size outputSize, const bool rgbOrder);
+
+    // Ask the kernel to start reading the next `count` upcoming frames from disk
+    void           adviseUpcomingFrames(const int count);
+
+private:
+    const uchar*   mapping           = nullptr;
+    size_t         mappingBytes      = 0;
+
+    cv::Size       dimensions;
+    ChromaFormat   chromaFormat      = ChromaFormat::e420;
+    double         fps               = 0.0;
+    int            numberOfFrames    = 0;
+    size_t         firstFrameOffset  = 0;      // Offset of the first frame's samples (after its header, in a Y4M file)
+    size_t         frameStride       = 0;      // Distance between the samples of consecutive frames
+    vector<size_t> frameOffsets;               // Only used when the frame headers of a Y4M file differ in length, so `frameStride` isn't constant
+
+    int            position          = 0;
+    int            decodedFrame      = -1;     // The frame "decoded" by the last call to grab() (-1 if there isn't one)
+    vector<int>    upcomingFrames;             // From prepareFrames()
+    size_t         nextUpcomingFrame = 0;      // The index in `upcomingFrames` of the next frame that hasn't been advised yet
+    Mat            i420;                       // Reused to hold shrunk planes
+
+    const static int framesToAdvise  = 2;
+};
+
+#endif /* RawYUVReader_hpp */
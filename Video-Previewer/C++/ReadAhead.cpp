@@ -0,0 +1,212 @@
+#include "ReadAhead.hpp"
+
+#include <algorithm>  // for std::min
+#include <cstring>    // for std::memcpy
+
+#include <fcntl.h>    // for open(), fcntl() and posix_fadvise()
+#include <sys/stat.h> // for fstat()
+#include <unistd.h>   // for pread() and close()
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ReadAheadFile
+   ----------------------------------------------------------------------------------------------------*/
+
+ReadAheadFile::ReadAheadFile(const string& filePathIn) : filePath{ filePathIn }
+{
+    fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        throw FileException("file could not be opened for reading\n", filePath);
+
+    struct stat status;
+    if (fstat(fileDescriptor, &status) != 0)
+    {
+        close(fileDescriptor);
+        throw FileException("size of file could not be determined\n", filePath);
+    }
+    fileSize = static_cast<uint64_t>(status.st_size);
+}
+
+ReadAheadFile::~ReadAheadFile()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    blocksChanged.notify_all();
+
+    if (readAheadThread.joinable())
+        readAheadThread.join();
+
+    close(fileDescriptor);
+}
+
+int64_t ReadAheadFile::read(const uint64_t offset, uint8_t* buffer, const size_t size)
+{
+    if (offset >= fileSize)
+        return 0;
+
+    const uint64_t end    = std::min<uint64_t>(offset + size, fileSize);
+    uint64_t       copied = 0;
+
+    while (offset + copied < end)
+    {
+        const uint64_t position   = offset + copied;
+        const uint64_t blockIndex = position / blockSize;
+
+        BlockPtr block { getBlock(blockIndex) };
+        if (!block)
+            return copied > 0 ? static_cast<int64_t>(copied) : -1;
+
+        const uint64_t blockStart = blockIndex * blockSize;
+        const uint64_t bytes      = std::min<uint64_t>(end, blockStart + block->size()) - position;
+        if (bytes == 0) // The file is shorter than it was when it was opened
+            break;
+
+        std::memcpy(buffer + copied, block->data() + (position - blockStart), bytes);
+        copied += bytes;
+    }
+
+    return static_cast<int64_t>(copied);
+}
+
+void ReadAheadFile::readAhead(const vector<ByteRange>& ranges)
+{
+    advise(ranges);
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+
+        // Blocks loaded for the old plan that haven't been read yet may still be read, but no longer hold the new plan back
+        plannedBlocks.clear();
+        unreadBlocks.clear();
+
+        for (const ByteRange& range : ranges)
+        {
+            if (range.size == 0 || range.offset >= fileSize)
+                continue;
+
+            const uint64_t lastBlock = (std::min(range.offset + range.size, fileSize) - 1) / blockSize;
+            for (uint64_t blockIndex = range.offset / blockSize; blockIndex <= lastBlock; ++blockIndex)
+                if (plannedBlocks.empty() || plannedBlocks.back() != blockIndex)
+                    plannedBlocks.push_back(blockIndex);
+        }
+
+        if (!readAheadThread.joinable() && !plannedBlocks.empty())
+            readAheadThread = std::thread(&ReadAheadFile::runReadAhead, this);
+    }
+    blocksChanged.notify_all();
+}
+
+void ReadAheadFile::advise(const vector<ByteRange>& ranges) const
+{
+    for (const ByteRange& range : ranges)
+    {
+        if (range.size == 0 || range.offset >= fileSize)
+            continue;
+
+        // Whole blocks, so that the operating system reads the same large, aligned pieces of the file as getBlock() does
+        const uint64_t start = range.offset / blockSize * blockSize;
+        const uint64_t end   = std::min((range.offset + range.size + blockSize - 1) / blockSize * blockSize, fileSize);
+
+#if defined(F_RDADVISE)
+        struct radvisory advisory;
+        advisory.ra_offset = static_cast<off_t>(start);
+        advisory.ra_count  = static_cast<int>(std::min<uint64_t>(end - start, INT32_MAX));
+        fcntl(fileDescriptor, F_RDADVISE, &advisory);
+#elif defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fileDescriptor, static_cast<off_t>(start), static_cast<off_t>(end - start), POSIX_FADV_WILLNEED);
+#endif
+    }
+}
+
+ReadAheadFile::BlockPtr ReadAheadFile::getBlock(const uint64_t blockIndex)
+{
+    std::unique_lock<std::mutex> lock { mutex };
+
+    // If the block is already being read (by the read-ahead thread), wait for it rather than read it a second time
+    blocksChanged.wait(lock, [&]() { return loadingBlocks.count(blockIndex) == 0; });
+
+    BlockPtr block;
+    auto cached = blocks.find(blockIndex);
+    if (cached != blocks.end())
+    {
+        block = cached->second;
+        recentlyUsed.remove(blockIndex);
+        recentlyUsed.push_front(blockIndex);
+    }
+    else
+        block = loadBlock(blockIndex, lock);
+
+    // Reading a block the read-ahead thread loaded lets it load another
+    if (unreadBlocks.erase(blockIndex) > 0)
+    {
+        lock.unlock();
+        blocksChanged.notify_all();
+    }
+
+    return block;
+}
+
+ReadAheadFile::BlockPtr ReadAheadFile::loadBlock(const uint64_t blockIndex, std::unique_lock<std::mutex>& lock)
+{
+    loadingBlocks.insert(blockIndex);
+    lock.unlock();
+
+    const uint64_t blockStart = blockIndex * blockSize;
+    const size_t   bytes      = static_cast<size_t>(std::min(blockSize, fileSize > blockStart ? fileSize - blockStart : 0));
+
+    std::shared_ptr<Block> block { std::make_shared<Block>(bytes) };
+    size_t                 done  = 0;
+    while (done < bytes)
+    {
+        ssize_t result = pread(fileDescriptor, block->data() + done, bytes - done, static_cast<off_t>(blockStart + done));
+        if (result <= 0)
+            break;
+        done += static_cast<size_t>(result);
+    }
+    block->resize(done);
+
+    lock.lock();
+    loadingBlocks.erase(blockIndex);
+
+    BlockPtr loaded;
+    if (done > 0)
+    {
+        loaded = block;
+        blocks[blockIndex] = loaded;
+        recentlyUsed.remove(blockIndex);
+        recentlyUsed.push_front(blockIndex);
+
+        while (blocks.size() > maxBlocks)
+        {
+            blocks.erase(recentlyUsed.back());
+            unreadBlocks.erase(recentlyUsed.back());
+            recentlyUsed.pop_back();
+        }
+    }
+
+    // Wake anyone waiting for this block (including to find that it couldn't be read)
+    blocksChanged.notify_all();
+    return loaded;
+}
+
+void ReadAheadFile::runReadAhead()
+{
+    std::unique_lock<std::mutex> lock { mutex };
+
+    while (true)
+    {
+        blocksChanged.wait(lock, [this]() { return stopping || (!plannedBlocks.empty() && unreadBlocks.size() < maxBlocksAhead); });
+        if (stopping)
+            return;
+
+        const uint64_t blockIndex = plannedBlocks.front();
+        plannedBlocks.pop_front();
+
+        if (blocks.count(blockIndex) > 0 || loadingBlocks.count(blockIndex) > 0)
+            continue;
+
+        if (loadBlock(blockIndex, lock))
+            unreadBlocks.insert(blockIndex);
+    }
+}
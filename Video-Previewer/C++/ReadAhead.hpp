@@ -0,0 +1,101 @@
+#ifndef ReadAhead_hpp
+#define ReadAhead_hpp
+
+#include <condition_variable> // for std::condition_variable
+#include <cstdint>            // for fixed width integer types
+#include <deque>              // for std::deque
+#include <list>               // for std::list
+#include <memory>             // for std::shared_ptr
+#include <mutex>              // for std::mutex
+#include <set>                // for std::set
+#include <thread>             // for std::thread
+#include <unordered_map>      // for std::unordered_map
+#include <vector>             // for std::vector
+
+#include "Exceptions.hpp"
+
+using std::string;
+using std::vector;
+
+// A contiguous part of a file
+struct ByteRange
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ReadAheadFile
+        Reads a file in large, aligned blocks, through a bounded cache of recently read blocks.
+
+        Demuxers read a little at a time, and after every seek (which, when sampling frames from
+        across a video, is every few frames) each read waits for the disk. On spinning disks and
+        network file systems that wait, rather than decoding, is most of the time spent. Told which
+        parts of the file are about to be read (see `readAhead()`), a background thread loads them
+        into the cache before the demuxer asks for them, so that the demuxer only waits for the
+        first of them.
+
+        The operating system is also told that every range in the plan will be needed soon (with
+        fcntl(F_RDADVISE) on macOS, or posix_fadvise() elsewhere), so that it can start reading them
+        into its own cache. That alone is all `advise()` does, which helps libraries that read the
+        file themselves (e.g. cv::VideoCapture) too.
+   ----------------------------------------------------------------------------------------------------*/
+
+class ReadAheadFile
+{
+public:
+    // Throws a FileException if the file can't be opened
+    ReadAheadFile(const string& filePathIn);
+    ~ReadAheadFile();
+
+    ReadAheadFile(const ReadAheadFile&)            = delete;
+    ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+
+    uint64_t getSize() const { return fileSize; }
+
+    // Copy up to `size` bytes from `offset` into `buffer` (as pread() would), returning how many were copied (-1 if the file couldn't be read)
+    int64_t  read(const uint64_t offset, uint8_t* buffer, const size_t size);
+
+    // Replace the plan with `ranges` (in the order they will be read), advise the operating system of them, and start loading them into the cache
+    // Blocks are loaded at most `maxBlocksAhead` ahead of the last block read
+    void     readAhead(const vector<ByteRange>& ranges);
+
+    // Only advise the operating system that `ranges` will be read soon
+    void     advise(const vector<ByteRange>& ranges) const;
+
+    const static uint64_t blockSize      = 512*1024; // Each read from the file is of a whole, aligned block
+    const static size_t   maxBlocks      = 32;       // The most blocks that are cached at once
+    const static size_t   maxBlocksAhead = 16;       // The most blocks loaded ahead of the reader that haven't been read yet
+
+private:
+    using Block    = vector<uint8_t>;
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    // Return block `blockIndex`, from the cache if it's there (or being loaded), and otherwise by reading it. Returns nullptr if it couldn't be read
+    BlockPtr getBlock(const uint64_t blockIndex);
+
+    // Read block `blockIndex` from the file and add it to the cache. `lock` must be held on `mutex`, and is released while the file is read
+    BlockPtr loadBlock(const uint64_t blockIndex, std::unique_lock<std::mutex>& lock);
+
+    // Load the blocks in `plannedBlocks` one after another, staying at most `maxBlocksAhead` blocks ahead of the reader. Run on `readAheadThread`
+    void     runReadAhead();
+
+private:
+    string                                    filePath;
+    int                                       fileDescriptor = -1;
+    uint64_t                                  fileSize       = 0;
+
+    std::unordered_map<uint64_t, BlockPtr>    blocks;           // The cached blocks, by index
+    std::list<uint64_t>                       recentlyUsed;     // The indexes of `blocks`, most recently used first
+    std::set<uint64_t>                        loadingBlocks;    // Blocks being read from the file, which other readers wait for rather than read again
+    std::deque<uint64_t>                      plannedBlocks;    // The blocks still to be loaded by `readAheadThread`, in order
+    std::set<uint64_t>                        unreadBlocks;     // Blocks loaded by `readAheadThread` that haven't been read yet
+    bool                                      stopping = false; // Tells `readAheadThread` to finish
+    std::mutex                                mutex;            // Guards everything above
+    std::condition_variable                   blocksChanged;    // Notified when a block is loaded or read, or the plan changes
+    std::thread                               readAheadThread;  // Started by the first call to readAhead()
+};
+
+using ReadAheadFilePtr = std::shared_ptr<ReadAheadFile>;
+
+#endif /* ReadAhead_hpp */
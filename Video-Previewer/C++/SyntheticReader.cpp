@@ -0,0 +1,130 @@
+#include "SyntheticReader.hpp"
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/imgproc.hpp>   // for cv::rectangle() and cv::putText()
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <algorithm> // for std::clamp()
+#include <chrono>    // for std::chrono::duration
+#include <sstream>   // for std::stringstream
+#include <thread>    // for std::this_thread::sleep_for()
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - SyntheticReader
+   ----------------------------------------------------------------------------------------------------*/
+
+SyntheticReader::Parameters SyntheticReader::parsePath(const string& filePath)
+{
+    Parameters parameters;
+
+    string spec  = filePath.substr(string(pathPrefix).size());
+    size_t query = spec.find('?');
+
+    try
+    {
+        string dimensions = spec.substr(0, query);
+        if (!dimensions.empty())
+        {
+            size_t separator = dimensions.find('x');
+            if (separator == string::npos)
+                throw FileException("the dimensions of a synthetic video should be given as WIDTHxHEIGHT\n", filePath);
+
+            parameters.dimensions = cv::Size(std::stoi(dimensions.substr(0, separator)), std::stoi(dimensions.substr(separator + 1)));
+        }
+
+        std::stringstream queryStream { query == string::npos ? "" : spec.substr(query + 1) };
+        string            parameter;
+        while (std::getline(queryStream, parameter, '&'))
+        {
+            size_t equals = parameter.find('=');
+            string key    = parameter.substr(0, equals);
+            string value  = equals == string::npos ? "" : parameter.substr(equals + 1);
+
+            if      (key == "frames")            parameters.numberOfFrames     = std::stoi(value);
+            else if (key == "fps")               parameters.fps                = std::stod(value);
+            else if (key == "decode_ms")         parameters.decodeMilliseconds = std::stod(value);
+            else if (key == "seek_ms")           parameters.seekMilliseconds   = std::stod(value);
+            else if (key == "keyframe_interval") parameters.keyframeInterval   = std::stoi(value);
+            else
+                throw FileException("\"" + key + "\" is not a parameter of a synthetic video\n", filePath);
+        }
+    }
+    catch (const std::logic_error&) // Thrown by std::stoi() and std::stod()
+    {
+        throw FileException("the parameters of a synthetic video should be numbers\n", filePath);
+    }
+
+    if (parameters.dimensions.empty() || parameters.numberOfFrames <= 0 || parameters.fps <= 0 || parameters.keyframeInterval <= 0)
+        throw FileException("the dimensions, frames, fps and keyframe_interval of a synthetic video should be positive\n", filePath);
+
+    return parameters;
+}
+
+void SyntheticReader::seek(const int frameNumber)
+{
+    // The same work as a real decoder: start decoding from the previous keyframe, and stop just before `frameNumber`
+    int keyframe = frameNumber - frameNumber % parameters.keyframeInterval;
+    simulateWork(parameters.seekMilliseconds + (frameNumber - keyframe)*parameters.decodeMilliseconds);
+
+    position     = std::clamp(frameNumber, 0, parameters.numberOfFrames);
+    decodedFrame = -1;
+}
+
+bool SyntheticReader::grab()
+{
+    if (position >= parameters.numberOfFrames)
+    {
+        decodedFrame = -1;
+        return false;
+    }
+
+    simulateWork(parameters.decodeMilliseconds);
+    decodedFrame = position++;
+    return true;
+}
+
+bool SyntheticReader::retrieve(Mat& frameOut)
+{
+    if (decodedFrame < 0)
+        return false;
+
+    const int width  = parameters.dimensions.width;
+    const int height = parameters.dimensions.height;
+
+    // A background colour that changes from frame to frame, a bar showing how far through the video the frame is, and the frame number
+    frameOut.create(height, width, CV_8UC3);
+    frameOut.setTo(cv::Scalar((decodedFrame*7) % 256, (decodedFrame*13) % 256, (decodedFrame*29) % 256));
+
+    int barPosition = static_cast<int>(static_cast<int64_t>(decodedFrame) * width / parameters.numberOfFrames);
+    cv::rectangle(frameOut, cv::Rect(barPosition, 0, std::max(width/100, 1), height), cv::Scalar(255, 255, 255), cv::FILLED);
+    cv::putText(frameOut, std::to_string(decodedFrame), cv::Point(width/20, height/2), cv::FONT_HERSHEY_SIMPLEX, height/200.0, cv::Scalar(255, 255, 255), std::max(height/200, 1));
+
+    return true;
+}
+
+vector<PacketInfo> SyntheticReader::getPackets() const
+{
+    vector<PacketInfo> packets;
+    packets.reserve(parameters.numberOfFrames);
+    for (int i = 0; i < parameters.numberOfFrames; ++i)
+        packets.push_back(PacketInfo{ i, i, i / parameters.fps, -1, 0, i % parameters.keyframeInterval == 0 });
+
+    return packets;
+}
+
+void SyntheticReader::simulateWork(const double milliseconds)
+{
+    if (milliseconds > 0)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(milliseconds));
+}
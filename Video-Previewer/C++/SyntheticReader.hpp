@@ -0,0 +1,67 @@
+#ifndef SyntheticReader_hpp
+#define SyntheticReader_hpp
+
+#include "VideoReader.hpp"
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - SyntheticReader
+        A `VideoReader` that draws its frames instead of decoding them, so that everything above the
+        decoder (sampling, caching, scheduling) can be measured without real video files, and gives the
+        same results every time.
+
+        The cost of decoding is simulated: each frame decoded waits for a fixed time, and a seek waits for
+        a fixed overhead and then "decodes" every frame from the previous keyframe, as a real decoder would.
+
+        Synthetic videos are opened through a path of the form (every part after "synthetic://" is optional)
+            synthetic://1280x720?frames=3000&fps=30&decode_ms=4&seek_ms=20&keyframe_interval=30
+   ----------------------------------------------------------------------------------------------------*/
+
+class SyntheticReader : public VideoReader
+{
+public:
+    struct Parameters
+    {
+        cv::Size dimensions         { 1280, 720 };
+        int      numberOfFrames     { 3000 };
+        double   fps                { 30.0 };
+        double   decodeMilliseconds { 0.0 };    // Per frame decoded
+        double   seekMilliseconds   { 0.0 };    // Per seek, on top of decoding forward from the previous keyframe
+        int      keyframeInterval   { 30 };
+    };
+
+    SyntheticReader(const Parameters& parametersIn) : parameters{ parametersIn } {}
+
+    // Whether `filePath` describes a synthetic video rather than a file
+    static bool       isSyntheticPath(const string& filePath) { return filePath.rfind(pathPrefix, 0) == 0; }
+
+    // Read the parameters out of a path of the form described above. Throws a FileException if the path can't be understood
+    static Parameters parsePath(const string& filePath);
+
+    bool     isOpened()          const override { return true; }
+    int      getPosition()       const override { return position; }
+    int      getNumberOfFrames() const override { return parameters.numberOfFrames; }
+    int      getCodec()          const override { return 0; }
+    double   getFPS()            const override { return parameters.fps; }
+    cv::Size getDimensions()     const override { return parameters.dimensions; }
+
+    void     seek(const int frameNumber) override;
+    bool     grab()                      override;
+    bool     retrieve(Mat& frameOut)     override;
+
+    // Every frame is its own packet, with time stamps counted in frames
+    vector<PacketInfo> getPackets()      const override;
+    bool               isContainerFile() const override { return false; }
+
+private:
+    // Block for `milliseconds`, standing in for the work a real decoder would do
+    static void simulateWork(const double milliseconds);
+
+private:
+    Parameters parameters;
+    int        position      = 0;
+    int        decodedFrame  = -1;  // The frame "decoded" by the last call to grab() (-1 if there isn't one)
+
+    constexpr static const char* pathPrefix = "synthetic://";
+};
+
+#endif /* SyntheticReader_hpp */
@@ -0,0 +1,115 @@
+#include "ThreadBudget.hpp"
+
+#include <iostream> // for std::cout
+#include <sstream>  // for std::ostringstream
+#include <thread>   // for std::thread::hardware_concurrency()
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ThreadAllocation
+   ----------------------------------------------------------------------------------------------------*/
+
+ThreadAllocation::~ThreadAllocation()
+{
+    budget.release(this);
+}
+
+void ThreadAllocation::release()
+{
+    budget.release(this);
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ThreadBudget
+   ----------------------------------------------------------------------------------------------------*/
+
+ThreadBudget& ThreadBudget::getInstance()
+{
+    // Never destroyed, so that allocations held by objects destroyed at exit can still be released
+    static ThreadBudget* budget = new ThreadBudget(static_cast<int>(std::thread::hardware_concurrency()));
+    return *budget;
+}
+
+ThreadAllocationPtr ThreadBudget::allocateDecoder(const string& description)
+{
+    ThreadAllocationPtr allocation { std::make_shared<ThreadAllocation>(*this, ThreadUse::eDecoder, description, 1) };
+
+    std::lock_guard<std::mutex> lock { mutex };
+    allocations.push_back(allocation.get());
+    rebalance();
+    return allocation;
+}
+
+ThreadAllocationPtr ThreadBudget::allocateWorkers(const int threads, const string& description)
+{
+    ThreadAllocationPtr allocation { std::make_shared<ThreadAllocation>(*this, ThreadUse::eWorkers, description, std::max(threads, 1)) };
+
+    std::lock_guard<std::mutex> lock { mutex };
+    allocations.push_back(allocation.get());
+    rebalance();
+    return allocation;
+}
+
+int ThreadBudget::getWorkerShare(const int requested) const
+{
+    std::lock_guard<std::mutex> lock { mutex };
+
+    int workerThreads = 0;
+    for (const ThreadAllocation* allocation : allocations)
+        if (allocation->use == ThreadUse::eWorkers)
+            workerThreads += allocation->getThreads();
+
+    return std::max(std::min(requested, (totalThreads - workerThreads) / 2), 1);
+}
+
+string ThreadBudget::getReport() const
+{
+    std::lock_guard<std::mutex> lock { mutex };
+
+    int allocatedThreads = 0;
+    for (const ThreadAllocation* allocation : allocations)
+        allocatedThreads += allocation->getThreads();
+
+    std::ostringstream report;
+    report << "Thread budget: " << allocatedThreads << " of " << totalThreads << " threads allocated\n";
+    for (const ThreadAllocation* allocation : allocations)
+        report << '\t' << (allocation->use == ThreadUse::eDecoder ? "decoder " : "workers ") << allocation->description << ": "
+               << allocation->getThreads() << (allocation->getThreads() == 1 ? " thread\n" : " threads\n");
+
+    return report.str();
+}
+
+void ThreadBudget::print() const
+{
+    std::cout << getReport();
+}
+
+void ThreadBudget::release(const ThreadAllocation* allocation)
+{
+    std::lock_guard<std::mutex> lock { mutex };
+    allocations.erase(std::remove(allocations.begin(), allocations.end(), allocation), allocations.end());
+    rebalance();
+}
+
+void ThreadBudget::rebalance()
+{
+    int workerThreads = 0;
+    int decoders      = 0;
+    for (const ThreadAllocation* allocation : allocations)
+    {
+        if (allocation->use == ThreadUse::eWorkers)
+            workerThreads += allocation->getThreads();
+        else
+            ++decoders;
+    }
+
+    if (decoders == 0)
+        return;
+
+    // The first few decoders get the threads left over from dividing evenly, so that none are wasted
+    const int freeThreads = std::max(totalThreads - workerThreads, 0);
+    int       decoder     = 0;
+    for (ThreadAllocation* allocation : allocations)
+        if (allocation->use == ThreadUse::eDecoder)
+            allocation->threads = std::max(freeThreads / decoders + (decoder++ < freeThreads % decoders ? 1 : 0), 1);
+}
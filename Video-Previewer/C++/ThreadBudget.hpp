@@ -0,0 +1,107 @@
+#ifndef ThreadBudget_hpp
+#define ThreadBudget_hpp
+
+#include <algorithm> // for std::max
+#include <atomic>    // for std::atomic
+#include <memory>    // for std::shared_ptr
+#include <mutex>     // for std::mutex
+#include <string>    // for std::string
+#include <vector>    // for std::vector
+
+using std::string;
+using std::vector;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ThreadBudget
+        Shares the processor's cores between everything in the process that runs on several threads:
+        the decoder inside every open video (libavcodec's frame and slice threads, or those of
+        cv::VideoCapture from OpenCV 4.6, the first version that lets them be limited), and the
+        threads that extract frames in parallel (see `VideoPreview::extractFramesInParallel()`). Left
+        to themselves, every decoder starts a thread per core, so a parallel extraction (which opens
+        a decoder per thread) or a few open previews run many times more threads than there are
+        cores, and each runs slower than it would alone.
+
+        Everything that uses threads holds a `ThreadAllocation` for as long as it does. Worker threads
+        are allocated exactly as many threads as they ask for, since they can't change once started;
+        getWorkerShare() says how many they should ask for. Decoders split whatever the workers leave,
+        evenly, with at least one thread each. Their shares are recalculated every time an allocation
+        is made or released, and each decoder picks up its new share the next time it can change its
+        number of threads.
+   ----------------------------------------------------------------------------------------------------*/
+
+enum class ThreadUse
+{
+    eDecoder, // A decoder's internal threads, recalculated as allocations come and go
+    eWorkers, // Threads of our own, fixed for as long as the allocation is held
+};
+
+class ThreadBudget;
+
+class ThreadAllocation
+{
+public:
+    ThreadAllocation(ThreadBudget& budgetIn, const ThreadUse useIn, const string& descriptionIn, const int threadsIn)
+        : budget{ budgetIn }, use{ useIn }, description{ descriptionIn }, threads{ threadsIn } {}
+    ~ThreadAllocation(); // Returns the threads to the budget
+
+    ThreadAllocation(const ThreadAllocation&)            = delete;
+    ThreadAllocation& operator=(const ThreadAllocation&) = delete;
+
+    // Return the threads to the budget before the allocation is destroyed, e.g. for a decoder that is stuck and will be closed whenever it finishes
+    void          release();
+
+    int           getThreads()     const { return threads.load(); }
+    ThreadUse     getUse()         const { return use; }
+    const string& getDescription() const { return description; }
+
+private:
+    friend class ThreadBudget;
+
+    ThreadBudget&    budget;
+    const ThreadUse  use;
+    const string     description;
+    std::atomic<int> threads;
+};
+
+using ThreadAllocationPtr = std::shared_ptr<ThreadAllocation>;
+
+class ThreadBudget
+{
+public:
+    // The budget shared by the whole process, of one thread per core
+    static ThreadBudget& getInstance();
+
+    ThreadBudget(const int totalThreadsIn) : totalThreads{ std::max(totalThreadsIn, 1) } {}
+
+    // Allocate a share of the threads left by the workers to a decoder, described (e.g. by its library and file) by `description`
+    ThreadAllocationPtr allocateDecoder(const string& description);
+
+    // Allocate exactly `threads` threads to a group of workers, whatever is left, since the caller has already decided to start them
+    ThreadAllocationPtr allocateWorkers(const int threads, const string& description);
+
+    // How many threads (up to `requested`) a group of workers should start, given what has already been allocated: half of the threads
+    // that no other workers hold, leaving the other half for the decoders that the workers will (generally) open
+    int    getWorkerShare(const int requested) const;
+
+    int    getTotalThreads() const { return totalThreads; }
+
+    // A line for the budget, then one for each allocation
+    string getReport() const;
+    void   print() const;
+
+private:
+    friend class ThreadAllocation;
+
+    // Remove `allocation` (which is being released or destroyed) from `allocations`, if it's still there
+    void   release(const ThreadAllocation* allocation);
+
+    // Recalculate the share of every decoder. `mutex` must already be held
+    void   rebalance();
+
+private:
+    const int                 totalThreads;
+    vector<ThreadAllocation*> allocations; // Every allocation that is still held, in the order they were made
+    mutable std::mutex        mutex;       // Guards `allocations`
+};
+
+#endif /* ThreadBudget_hpp */
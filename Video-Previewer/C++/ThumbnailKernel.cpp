@@ -0,0 +1,380 @@
+#include "ThumbnailKernel.hpp"
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/imgproc.hpp>   // for cv::resize() and cv::cvtColor()
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <algorithm> // for std::fill() and std::min()
+#include <chrono>    // for std::chrono::steady_clock
+#include <cstdint>   // for fixed width integer types
+#include <iostream>  // for std::cout and std::cerr
+#include <limits>    // for std::numeric_limits
+#include <map>       // for std::map
+#include <mutex>     // for std::mutex
+#include <tuple>     // for std::tuple
+#include <vector>    // for std::vector
+
+#if defined(__x86_64__) || defined(__i386__)
+#define THUMBNAIL_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Row summing
+        Add each byte of `row` to the corresponding element of `sums`
+   ----------------------------------------------------------------------------------------------------*/
+
+using SumRowFunction = void (*)(const uchar* row, uint32_t* sums, const size_t length);
+
+static void sumRowScalar(const uchar* row, uint32_t* sums, const size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        sums[i] += row[i];
+}
+
+#ifdef THUMBNAIL_KERNEL_X86
+
+__attribute__((target("sse4.1")))
+static void sumRowSSE41(const uchar* row, uint32_t* sums, const size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i* out  = reinterpret_cast<__m128i*>(sums + i);
+
+        _mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), _mm_cvtepu8_epi32(bytes)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4))));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8))));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12))));
+    }
+
+    sumRowScalar(row + i, sums + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void sumRowAVX2(const uchar* row, uint32_t* sums, const size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i  bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m256i* out   = reinterpret_cast<__m256i*>(sums + i);
+
+        _mm256_storeu_si256(out + 0, _mm256_add_epi32(_mm256_loadu_si256(out + 0), _mm256_cvtepu8_epi32(bytes)));
+        _mm256_storeu_si256(out + 1, _mm256_add_epi32(_mm256_loadu_si256(out + 1), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8))));
+    }
+
+    sumRowScalar(row + i, sums + i, length - i);
+}
+
+#endif /* THUMBNAIL_KERNEL_X86 */
+
+// Whether `candidate` gives exactly the same sums as sumRowScalar()
+static bool matchesScalar(const SumRowFunction candidate)
+{
+    const size_t length = 16*37 + 11; // Not a multiple of any vector width, so the scalar tail is checked too
+
+    vector<uchar> row (length);
+    for (size_t i = 0; i < length; ++i)
+        row[i] = static_cast<uchar>(i % 3 == 0 ? 255 : (i*37 + 11) & 0xFF);
+
+    vector<uint32_t> expected (length, 0xFFFF0000u); // Large starting values, to catch any narrowing of the sums
+    vector<uint32_t> actual   (expected);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        sumRowScalar(row.data(), expected.data(), length);
+        candidate(row.data(), actual.data(), length);
+    }
+
+    return actual == expected;
+}
+
+struct RowSummer
+{
+    const char*    name;
+    SumRowFunction sumRow;
+};
+
+// The fastest implementation this processor supports that passes matchesScalar(). Chosen the first time it's needed
+static const RowSummer& getRowSummer()
+{
+    static const RowSummer summer = []
+    {
+        vector<RowSummer> candidates;
+#ifdef THUMBNAIL_KERNEL_X86
+        if (__builtin_cpu_supports("avx2"))   candidates.push_back({ "avx2",   sumRowAVX2 });
+        if (__builtin_cpu_supports("sse4.1")) candidates.push_back({ "sse4.1", sumRowSSE41 });
+#endif
+
+        for (const RowSummer& candidate : candidates)
+        {
+            if (matchesScalar(candidate.sumRow))
+                return candidate;
+
+            std::cerr << "The " << candidate.name << " thumbnail kernel gave the wrong result, so will not be used\n";
+        }
+
+        return RowSummer{ "scalar", sumRowScalar };
+    }();
+
+    return summer;
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Packing
+        Average the summed BGR samples under each destination pixel in a row, and write them out
+   ----------------------------------------------------------------------------------------------------*/
+
+// Each average is rounded as cv::resize() rounds it with INTER_AREA when the frame is an exact multiple of the thumbnail's size: blocks
+// of 2x2 pixels round halves up, and every other block is scaled in single precision and rounded to the nearest (even) integer
+template <PixelPacking packing>
+static void packRow(const uint32_t* sums, const vector<int>& columnStarts, const int rowsSummed, uchar* destination)
+{
+    const int width = static_cast<int>(columnStarts.size()) - 1;
+
+    for (int x = 0; x < width; ++x)
+    {
+        // A whole block can add up to more than 32 bits hold (e.g. a 1 pixel wide thumbnail of an 8K frame), although a single column can't
+        uint64_t blue = 0, green = 0, red = 0;
+        for (int column = columnStarts[x]; column < columnStarts[x + 1]; ++column)
+        {
+            blue  += sums[3*column + 0];
+            green += sums[3*column + 1];
+            red   += sums[3*column + 2];
+        }
+
+        const int   columns = columnStarts[x + 1] - columnStarts[x];
+        const bool  halfUp  = columns == 2 && rowsSummed == 2;
+        const float scale   = 1.f / (static_cast<float>(columns) * rowsSummed);
+
+        auto average = [=](const uint64_t sum) { return halfUp ? static_cast<uchar>((sum + 2) >> 2) : cv::saturate_cast<uchar>(static_cast<float>(sum) * scale); };
+
+        const uchar b = average(blue);
+        const uchar g = average(green);
+        const uchar r = average(red);
+
+        switch (packing)
+        {
+            case PixelPacking::eRGB:  destination[0] = r; destination[1] = g; destination[2] = b;                       destination += 3; break;
+            case PixelPacking::eRGBA: destination[0] = r; destination[1] = g; destination[2] = b; destination[3] = 255; destination += 4; break;
+            case PixelPacking::eBGRA: destination[0] = b; destination[1] = g; destination[2] = r; destination[3] = 255; destination += 4; break;
+        }
+    }
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - Single pass
+   ----------------------------------------------------------------------------------------------------*/
+
+// shrinkAndPack(), summing rows with `summer`, for arguments that have already been checked
+static void shrinkAndPackSinglePass(const Mat& source, uchar* destination, const cv::Size destinationSize, const size_t destinationStride, const PixelPacking packing, const RowSummer& summer)
+{
+    // The first source column under each destination column (and, at the end, one past the last source column)
+    vector<int> columnStarts (destinationSize.width + 1);
+    for (int x = 0; x <= destinationSize.width; ++x)
+        columnStarts[x] = static_cast<int>(static_cast<int64_t>(x) * source.cols / destinationSize.width);
+
+    const size_t     rowLength = static_cast<size_t>(source.cols) * 3;
+    vector<uint32_t> sums (rowLength);
+
+    for (int y = 0; y < destinationSize.height; ++y)
+    {
+        const int firstRow = static_cast<int>(static_cast<int64_t>(y)     * source.rows / destinationSize.height);
+        const int endRow   = static_cast<int>(static_cast<int64_t>(y + 1) * source.rows / destinationSize.height);
+
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int row = firstRow; row < endRow; ++row)
+            summer.sumRow(source.ptr<uchar>(row), sums.data(), rowLength);
+
+        uchar* out = destination + y*destinationStride;
+        switch (packing)
+        {
+            case PixelPacking::eRGB:  packRow<PixelPacking::eRGB> (sums.data(), columnStarts, endRow - firstRow, out); break;
+            case PixelPacking::eRGBA: packRow<PixelPacking::eRGBA>(sums.data(), columnStarts, endRow - firstRow, out); break;
+            case PixelPacking::eBGRA: packRow<PixelPacking::eBGRA>(sums.data(), columnStarts, endRow - firstRow, out); break;
+        }
+    }
+}
+
+// Whether the single pass (with `summer`) gives exactly what cv::resize() with INTER_AREA then cv::cvtColor() give, for frames that are an
+// exact multiple of the thumbnail's size in each direction (the only sizes for which the two average the same pixels)
+static bool matchesResize(const RowSummer& summer)
+{
+    const cv::Size frameSize { 60, 36 };
+    const cv::Size thumbnailSizes[] { { 30, 18 }, { 20, 12 }, { 15, 9 }, { 20, 18 }, { 12, 9 }, { 60, 12 }, { 1, 1 } }; // 2x2, 3x3, 4x4, 3x2, 5x4, 1x3 and the whole frame
+
+    // Pseudo-random, so that every rounding case (including exact halves) comes up
+    Mat      frame  { frameSize, CV_8UC3 };
+    uint32_t random = 12345;
+    for (int y = 0; y < frame.rows; ++y)
+        for (int x = 0; x < 3*frame.cols; ++x)
+            frame.ptr<uchar>(y)[x] = static_cast<uchar>((random = random*1103515245u + 12345u) >> 24);
+
+    const std::tuple<PixelPacking, int, int> packings[] { { PixelPacking::eRGB,  CV_8UC3, cv::COLOR_BGR2RGB  },
+                                                          { PixelPacking::eRGBA, CV_8UC4, cv::COLOR_BGR2RGBA },
+                                                          { PixelPacking::eBGRA, CV_8UC4, cv::COLOR_BGR2BGRA } };
+
+    for (const cv::Size& thumbnailSize : thumbnailSizes)
+    {
+        Mat shrunk;
+        cv::resize(frame, shrunk, thumbnailSize, 0, 0, cv::INTER_AREA);
+
+        for (const auto& [packing, type, conversion] : packings)
+        {
+            Mat expected, actual { thumbnailSize, type };
+            cv::cvtColor(shrunk, expected, conversion);
+            shrinkAndPackSinglePass(frame, actual.data, thumbnailSize, actual.step[0], packing, summer);
+
+            if (cv::norm(expected, actual, cv::NORM_INF) != 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// The row summer used by shrinkAndPack(), or nullptr if the single pass doesn't give the same thumbnails as OpenCV on this machine. Checked
+// the first time it's needed
+static const RowSummer* getExactRowSummer()
+{
+    static const RowSummer* summer = []() -> const RowSummer*
+    {
+        if (matchesResize(getRowSummer()))
+            return &getRowSummer();
+
+        std::cerr << "The single pass thumbnail kernel gave different thumbnails to cv::resize(), so will not be used\n";
+        return nullptr;
+    }();
+
+    return summer;
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ThumbnailKernel
+   ----------------------------------------------------------------------------------------------------*/
+
+bool shrinkAndPack(const Mat& source, uchar* destination, const cv::Size destinationSize, const size_t destinationStride, const PixelPacking packing)
+{
+    if (source.type() != CV_8UC3 || destinationSize.empty() || destinationSize.width > source.cols || destinationSize.height > source.rows)
+        return false;
+
+    const RowSummer* summer = getExactRowSummer();
+    if (!summer)
+        return false;
+
+    shrinkAndPackSinglePass(source, destination, destinationSize, destinationStride, packing, *summer);
+    return true;
+}
+
+bool shrinkAndPack(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing)
+{
+    Mat packed { destinationSize, packing == PixelPacking::eRGB ? CV_8UC3 : CV_8UC4 }; // Always new, so never shares data with `source`
+
+    if (!shrinkAndPack(source, packed.data, destinationSize, packed.step[0], packing))
+        return false;
+
+    destination = packed;
+    return true;
+}
+
+string getThumbnailKernelName()
+{
+    const RowSummer* summer = getExactRowSummer();
+    return summer ? summer->name : "opencv";
+}
+
+bool isIPPAvailable()
+{
+    return cv::ipp::useIPP();
+}
+
+bool shrinkAndPackIPP(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing)
+{
+    if (source.type() != CV_8UC3 || destinationSize.empty() || destinationSize.width > source.cols || destinationSize.height > source.rows)
+        return false;
+
+    const bool wasNotExact = cv::ipp::useIPP_NotExact();
+    cv::ipp::setUseIPP_NotExact(true);
+
+    Mat shrunk;
+    cv::resize(source, shrunk, destinationSize, 0, 0, cv::INTER_AREA);
+
+    cv::ipp::setUseIPP_NotExact(wasNotExact);
+
+    Mat packed; // Always new, so never shares data with `source`
+    switch (packing)
+    {
+        case PixelPacking::eRGB:  cv::cvtColor(shrunk, packed, cv::COLOR_BGR2RGB);  break;
+        case PixelPacking::eRGBA: cv::cvtColor(shrunk, packed, cv::COLOR_BGR2RGBA); break;
+        case PixelPacking::eBGRA: cv::cvtColor(shrunk, packed, cv::COLOR_BGR2BGRA); break;
+    }
+
+    destination = packed;
+    return true;
+}
+
+bool shrinkAndPackFastest(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing)
+{
+    if (!isIPPAvailable())
+        return shrinkAndPack(source, destination, destinationSize, packing);
+
+    using Sizes = std::tuple<int, int, int, int>;
+
+    static std::mutex            choicesMutex;
+    static std::map<Sizes, bool> useIPP; // For each frame and thumbnail size, whether shrinkAndPackIPP() was the faster
+
+    const Sizes sizes { source.cols, source.rows, destinationSize.width, destinationSize.height };
+    {
+        std::lock_guard<std::mutex> lock { choicesMutex };
+
+        auto choice = useIPP.find(sizes);
+        if (choice != useIPP.end())
+            return choice->second ? shrinkAndPackIPP(source, destination, destinationSize, packing) : shrinkAndPack(source, destination, destinationSize, packing);
+    }
+
+    // The best of a few runs of each, so that the first run (which may have to warm up caches, or allocate) doesn't decide it
+    auto fastestMilliseconds = [&](bool (*shrink)(const Mat&, Mat&, const cv::Size, const PixelPacking))
+    {
+        const int runs = 3;
+        double    best = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; ++run)
+        {
+            auto startTime = std::chrono::steady_clock::now();
+            if (!shrink(source, destination, destinationSize, packing))
+                return best;
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+        }
+        return best;
+    };
+
+    const double ippMilliseconds    = fastestMilliseconds(shrinkAndPackIPP);
+    const double kernelMilliseconds = fastestMilliseconds(shrinkAndPack);    // Leaves its result in `destination`
+    const bool   ippIsFaster        = ippMilliseconds < kernelMilliseconds;
+
+    std::cout << "Thumbnails from " << source.cols << "x" << source.rows << " to " << destinationSize.width << "x" << destinationSize.height << ": "
+              << kernelMilliseconds << " ms in a single pass (" << getThumbnailKernelName() << "), " << ippMilliseconds << " ms with IPP " << cv::ipp::getIppVersion()
+              << "; using " << (ippIsFaster ? "IPP" : "the single pass") << "\n";
+
+    std::lock_guard<std::mutex> lock { choicesMutex };
+    useIPP[sizes] = ippIsFaster;
+
+    return kernelMilliseconds < std::numeric_limits<double>::max();
+}
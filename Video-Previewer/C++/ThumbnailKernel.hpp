@@ -0,0 +1,77 @@
+#ifndef ThumbnailKernel_hpp
+#define ThumbnailKernel_hpp
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/core/mat.hpp>  // for basic OpenCV structures (Mat, Scalar)
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <string> // for std::string
+
+using cv::Mat;
+using std::string;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - ThumbnailKernel
+        Shrinks a decoded frame to a thumbnail, converts its colours and packs it for display, all in a
+        single pass over the frame (rather than one pass each for cv::resize(), cv::cvtColor() and
+        copying it out).
+
+        Each thumbnail pixel is the average of the block of frame pixels it covers, with block edges
+        rounded down to whole pixels. The source rows under each thumbnail row are summed with SSE4.1
+        or AVX2 where the processor supports them (chosen at run time), which is where nearly all of
+        the time goes; everything else is scalar. Before a vectorised path is first used it is checked
+        against the scalar one, and only used if it gives exactly the same sums.
+
+        Where the frame is an exact multiple of the thumbnail's size, the blocks are the same as those
+        cv::resize() averages with INTER_AREA, and each average is rounded the same way too. Before the
+        kernel is first used, the whole of it is checked against cv::resize() and cv::cvtColor() for a
+        few such sizes, and if it doesn't give exactly the same thumbnails it isn't used at all.
+
+        Where OpenCV was built with IPP (x86 builds, including the Homebrew one) and it's enabled on this
+        processor, the same job can instead be done by cv::resize() and cv::cvtColor(), which OpenCV
+        hands on to IPP's optimised routines. Which is faster depends on the processor and the sizes
+        involved, so shrinkAndPackFastest() times both the first time it sees each pair of sizes.
+   ----------------------------------------------------------------------------------------------------*/
+
+// How thumbnail pixels are laid out in memory. Alpha, where present, is always opaque
+enum class PixelPacking
+{
+    eRGB,
+    eRGBA,
+    eBGRA,
+};
+
+// Shrink `source` (8-bit BGR) to `destinationSize`, writing it to `destination` packed as `packing`, with rows `destinationStride` bytes apart
+// Returns false (writing nothing) if `source` isn't 8-bit BGR, `destinationSize` is empty or bigger than `source` in either direction, or
+// the kernel failed its check against cv::resize() (see getThumbnailKernelName())
+bool shrinkAndPack(const Mat& source, uchar* destination, const cv::Size destinationSize, const size_t destinationStride, const PixelPacking packing);
+
+// The same, overwriting `destination` with a new `Mat` (CV_8UC3 for eRGB, otherwise CV_8UC4)
+bool shrinkAndPack(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing);
+
+// Which implementation shrinkAndPack() sums rows with: "avx2", "sse4.1" or "scalar" ("opencv" if the kernel isn't used, as it didn't match cv::resize())
+string getThumbnailKernelName();
+
+// Whether OpenCV can use IPP on this processor
+bool isIPPAvailable();
+
+// The same as shrinkAndPack(), but in two passes (shrinking, then converting), with OpenCV using IPP for both where it can
+// IPP's area resize doesn't round exactly as OpenCV's own does, so is only used when OpenCV's "not exact" IPP mode is on; this turns it on
+// (for this thread) for the duration of the resize
+bool shrinkAndPackIPP(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing);
+
+// Whichever of shrinkAndPack() and shrinkAndPackIPP() is faster for these sizes, timed on `source` the first time they're seen
+bool shrinkAndPackFastest(const Mat& source, Mat& destination, const cv::Size destinationSize, const PixelPacking packing);
+
+#endif /* ThumbnailKernel_hpp */
@@ -0,0 +1,104 @@
+#include "VideoReader.hpp"
+#include "ImageSequenceReader.hpp"
+#include "LibavReader.hpp"
+#include "RawYUVReader.hpp"
+#include "SyntheticReader.hpp"
+#include "ThumbnailKernel.hpp"
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/imgproc.hpp>   // for cv::resize() and cv::cvtColor()
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - VideoReader
+   ----------------------------------------------------------------------------------------------------*/
+
+VideoReaderPtr openVideoReader(const string& filePath, const VideoReaderSettings& settings)
+{
+    VideoReaderPtr reader;
+
+    // Whatever the backend
+    if (SyntheticReader::isSyntheticPath(filePath))
+        return std::make_shared<SyntheticReader>(SyntheticReader::parsePath(filePath));
+
+    if (ImageSequenceReader::isImageSequencePath(filePath))
+        reader = std::make_shared<ImageSequenceReader>(filePath, settings.defaultFPS);
+    else if (RawYUVReader::isRawYUVPath(filePath))
+        reader = std::make_shared<RawYUVReader>(filePath, settings.defaultFPS);
+    else switch (settings.backend)
+    {
+        case VideoBackend::eLibav:
+#ifdef VIDEO_PREVIEWER_LIBAV
+            reader = std::make_shared<LibavReader>(filePath, settings.defaultFPS);
+            break;
+#else
+            std::cerr << "Video-Previewer was built without libav support (VIDEO_PREVIEWER_LIBAV), so OpenCV is used instead\n";
+            [[fallthrough]];
+#endif
+        case VideoBackend::eOpenCV:
+            reader = std::make_shared<OpenCVReader>(filePath);
+            break;
+    }
+
+    if (!reader->isOpened())
+        throw FileException("file either could not be opened or is not an accepted format\n", filePath);
+
+    return reader;
+}
+
+void makeThumbnail(const Mat& decodedFrame, Mat& thumbnailOut, const cv::Size thumbnailSize)
+{
+    if (decodedFrame.empty())
+        thumbnailOut.release();
+    else if (decodedFrame.size() == thumbnailSize)
+        cv::cvtColor(decodedFrame, thumbnailOut, cv::COLOR_BGR2RGB);
+    else if (!shrinkAndPackFastest(decodedFrame, thumbnailOut, thumbnailSize, PixelPacking::eRGB)) // Only shrinks 8-bit BGR frames
+    {
+        cv::resize(decodedFrame, thumbnailOut, thumbnailSize, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(thumbnailOut, thumbnailOut, cv::COLOR_BGR2RGB);
+    }
+}
+
+string videoBackendToString(const VideoBackend backend)
+{
+    switch (backend)
+    {
+        case VideoBackend::eOpenCV: return "opencv";
+        case VideoBackend::eLibav:  return "libav";
+    }
+    return "";
+}
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - OpenCVReader
+   ----------------------------------------------------------------------------------------------------*/
+
+OpenCVReader::OpenCVReader(const string& filePath)
+{
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+    threads = ThreadBudget::getInstance().allocateDecoder("\"" + filePath + "\" (opencv)");
+    vc.open(filePath, cv::CAP_ANY, { cv::CAP_PROP_N_THREADS, threads->getThreads() });
+#else
+    // The capture decodes on FFmpeg's default number of threads, which can't be changed, so it doesn't take a share of the budget either
+    // (cv::setNumThreads() only limits OpenCV's own parallel loops, for the whole process, not the decoder's threads)
+    vc.open(filePath);
+#endif
+
+    try
+    {
+        file = std::make_shared<ReadAheadFile>(filePath);
+    }
+    catch (const FileException&) {} // Read-ahead is only ever an optimisation
+}
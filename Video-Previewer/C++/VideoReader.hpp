@@ -0,0 +1,193 @@
+#ifndef VideoReader_hpp
+#define VideoReader_hpp
+
+#if defined(__has_warning)
+#if __has_warning("-Wreserved-id-macro")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#endif
+#endif
+
+#include <opencv2/core/mat.hpp>  // for basic OpenCV structures (Mat, Scalar)
+#include <opencv2/videoio.hpp>
+
+#if defined(__has_warning)
+#if __has_warning("-Wdocumentation")
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#include <cstdint> // for fixed width integer types
+#include <memory>  // for std::shared_ptr
+#include <vector>  // for std::vector
+
+#include "Exceptions.hpp"
+#include "ReadAhead.hpp"
+#include "ThreadBudget.hpp"
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - PacketInfo
+        What the demuxer knows about a single compressed frame of the video track, without decoding it
+   ----------------------------------------------------------------------------------------------------*/
+
+struct PacketInfo
+{
+    int64_t  pts;        // Presentation and decode time stamps, in units of the stream's time base (`unknownTimestamp` if not known)
+    int64_t  dts;
+    double   seconds;    // The presentation time stamp (or the decode time stamp, if that isn't known) in seconds from the start of the stream
+    int64_t  position;   // The offset of the packet in the file (-1 if unknown)
+    uint32_t size;       // The size of the packet in bytes (0 if unknown)
+    bool     isKeyframe;
+
+    const static int64_t unknownTimestamp = INT64_MIN;
+};
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - VideoReader
+        The part of a video decoder that `Video` is built on: opening a file, seeking, and decoding the
+        frames one after another. Each implementation wraps a different library, chosen at runtime by
+        the "video_backend" option (see `openVideoReader()`).
+
+        Frame numbers are indexed from 0, in presentation order, as in OpenCV.
+   ----------------------------------------------------------------------------------------------------*/
+
+enum class VideoBackend
+{
+    eOpenCV, // cv::VideoCapture
+    eLibav,  // libavformat and libavcodec directly (see LibavReader.hpp). Only available when built with VIDEO_PREVIEWER_LIBAV
+};
+
+// Overwrite `thumbnailOut` with `decodedFrame` (8-bit BGR) shrunk to `thumbnailSize` and converted to RGB, in a single pass over the frame
+// where possible (see ThumbnailKernel.hpp). `thumbnailOut` never shares data with `decodedFrame`, so the decoder can reuse its buffer
+void makeThumbnail(const Mat& decodedFrame, Mat& thumbnailOut, const cv::Size thumbnailSize);
+
+class VideoReader
+{
+public:
+    virtual ~VideoReader() = default;
+
+    virtual bool     isOpened()          const = 0;
+    virtual int      getPosition()       const = 0; // The next frame that grab() will decode
+    virtual int      getNumberOfFrames() const = 0;
+    virtual int      getCodec()          const = 0; // As a FourCC
+    virtual double   getFPS()            const = 0;
+    virtual cv::Size getDimensions()     const = 0;
+
+    // Move so that `frameNumber` is the next frame that grab() will decode. This may decode frames (e.g. from the previous keyframe)
+    virtual void     seek(const int frameNumber) = 0;
+
+    // Decode the next frame, without converting it to a `Mat`. Returns false at the end of the video
+    virtual bool     grab() = 0;
+
+    // Overwrite `frameOut` with the frame decoded by the last call to grab(), as 8-bit BGR
+    virtual bool     retrieve(Mat& frameOut) = 0;
+
+    // The same as retrieve(), but shrunk to `thumbnailSize`, and in RGB order (which is how the GUI shows it). `thumbnailOut` never shares
+    // data with the reader. Readers that can shrink the frame in its native format, before any colour conversion, should override this
+    virtual bool     retrieveThumbnail(Mat& thumbnailOut, const cv::Size thumbnailSize)
+    {
+        if (!retrieve(retrievedFrame))
+            return false;
+
+        makeThumbnail(retrievedFrame, thumbnailOut, thumbnailSize);
+        return true;
+    }
+
+    // grab() then retrieve() (or retrieveThumbnail(), if `thumbnailSize` isn't empty). `frameOut` is released if there is no frame to read
+    bool             read(Mat& frameOut, const cv::Size thumbnailSize = {})
+    {
+        if (grab() && (thumbnailSize.empty() ? retrieve(frameOut) : retrieveThumbnail(frameOut, thumbnailSize)))
+            return true;
+
+        frameOut.release();
+        return false;
+    }
+
+    // Every packet of the video track known to the demuxer, in decode order. Empty if the library doesn't expose packets
+    virtual vector<PacketInfo> getPackets() const { return {}; }
+
+    // Whether the video is a single container file, which `ContainerIndex` may be able to read
+    virtual bool     isContainerFile()   const { return true; }
+
+    // How many frames before the target of a seek the reader starts looking for a keyframe to decode from (see `DecodeCostModel`)
+    virtual int      getSeekPreroll()    const { return 0; }
+
+    // Told which frames are about to be requested (in increasing order), so that readers that can load frames ahead of time can start
+    virtual void     prepareFrames(const vector<int>& /*frameNumbers*/) {}
+
+    // Told which parts of the file the frames about to be requested are stored in (in the order they will be read), so that readers that
+    // read the file can start reading them (see `ReadAheadFile`)
+    virtual void     readAhead(const vector<ByteRange>& /*ranges*/) {}
+
+    // Give the reader's share of the `ThreadBudget` back early, because it is stuck and being abandoned (see Video::decodeFrame())
+    // Its decoder keeps whatever threads it already has until it is closed, but the other decoders' shares no longer make room for them
+    virtual void     releaseThreads() {}
+
+private:
+    Mat              retrievedFrame; // Reused by retrieveThumbnail()
+};
+
+using VideoReaderPtr = std::shared_ptr<VideoReader>;
+
+// How openVideoReader() should open a video
+struct VideoReaderSettings
+{
+    VideoBackend backend    = VideoBackend::eOpenCV;
+    double       defaultFPS = 24.0;                        // For image sequences and raw .yuv files, which don't record a frame rate, and video tracks that don't
+};
+
+// Open `filePath` with the library corresponding to `settings.backend`. Falls back to OpenCV (with a message on std::cerr) if that
+// library wasn't built in. Paths starting with "synthetic://" open a `SyntheticReader`, and directories or printf-style patterns
+// (e.g. "frames/%04d.png") open an `ImageSequenceReader`, and .y4m and .yuv files a `RawYUVReader`, whatever the backend. Throws a FileException if the file can't be opened
+VideoReaderPtr openVideoReader(const string& filePath, const VideoReaderSettings& settings);
+
+// Human-readable name of a `VideoBackend`, for diagnostics
+string videoBackendToString(const VideoBackend backend);
+
+
+/*----------------------------------------------------------------------------------------------------
+    MARK: - OpenCVReader
+        A `VideoReader` that is a thin wrapper around a cv::VideoCapture
+
+        From OpenCV 4.6, the capture is opened to decode on the reader's share of the `ThreadBudget`,
+        which it keeps until it is closed (OpenCV only lets it be set when the capture is opened).
+        Earlier versions can't limit the capture's threads at all, so the reader takes no share, and
+        the budget only divides the cores between libav readers and worker threads.
+
+        OpenCV reads the file itself, so read-ahead can only ask the operating system to read the
+        upcoming parts of the file into its cache (see `ReadAheadFile::advise()`).
+   ----------------------------------------------------------------------------------------------------*/
+
+class OpenCVReader : public VideoReader
+{
+public:
+    OpenCVReader() {};
+    OpenCVReader(const string& filePath);
+
+    bool     isOpened()          const override { return vc.isOpened(); }
+    int      getPosition()       const override { return vc.get(cv::CAP_PROP_POS_FRAMES); }
+    int      getNumberOfFrames() const override { return vc.get(cv::CAP_PROP_FRAME_COUNT); }
+    int      getCodec()          const override { return vc.get(cv::CAP_PROP_FOURCC); }
+    double   getFPS()            const override { return vc.get(cv::CAP_PROP_FPS); }
+    cv::Size getDimensions()     const override { return cv::Size(vc.get(cv::CAP_PROP_FRAME_WIDTH), vc.get(cv::CAP_PROP_FRAME_HEIGHT)); }
+    int      getSeekPreroll()    const override { return 16; } // cv::VideoCapture starts looking for a keyframe 16 frames before the target
+
+    void     seek(const int frameNumber) override { vc.set(cv::CAP_PROP_POS_FRAMES, frameNumber); }
+    bool     grab()                      override { return vc.grab(); }
+    bool     retrieve(Mat& frameOut)     override { return vc.retrieve(frameOut); }
+
+    void     readAhead(const vector<ByteRange>& ranges) override { if (file) file->advise(ranges); }
+    void     releaseThreads()                           override { if (threads) threads->release(); }
+
+private:
+    cv::VideoCapture    vc;
+    ThreadAllocationPtr threads; // This reader's share of the thread budget. nullptr before OpenCV 4.6
+    ReadAheadFilePtr    file;    // Only used to advise the operating system. nullptr if the file couldn't be opened (e.g. OpenCV was given a URL)
+};
+
+#endif /* VideoReader_hpp */
@@ -62,9 +62,19 @@
 - (void)                      setCols:(const int)cols;
 - (NSNumber*)                 getRows;
 - (NSNumber*)                 getCols;
+- (void)                      setViewportFirstRow:(const int)firstRow lastRow:(const int)lastRow cols:(const int)cols velocity:(const double)velocity; // The rows currently on screen, which are decoded first
 
 - (NSNumber*)                 getNumOfFrames;
+- (NSNumber*)                 getFramesVersion;                          // Changes every time the backend makes a new set of frames
+- (NSNumber*)                 getCompleteness;                           // The fraction of the frames that are final (less than 1 while frames are made in the background)
 - (NSArray<NSFramePreview*>*) getFrames;                                 // Returns an array consisting of a NSFramePreview for each frame in the preview
 
+- (void)                      selectFrame:(const int)frameNumber;        // `frameNumber` as returned by NSFramePreview's getFrameNumber. The frames around it are decoded in the background
+- (NSFramePreview*)           stepSelectedFrame:(const int)offset;       // Moves the selection by `offset` frames and returns the new frame (nil if there isn't one)
+
+- (NSArray<NSFramePreview*>*) zoomInFrom:(const int)firstFrameNumber to:(const int)lastFrameNumber; // A denser preview of the frames between two frames (as numbered by NSFramePreview)
+- (NSArray<NSFramePreview*>*) zoomOut;                                   // Returns the frames of the level above (the preview's frames once fully zoomed out)
+- (NSNumber*)                 getZoomDepth;
+
 
 @end
@@ -33,15 +33,15 @@
 
 // Iitialize an NSFramePreview from a Frame
 // Adapted from https://docs.opencv.org/master/d3/def/tutorial_image_manipulation.html
-- (NSFramePreview*) initFromFrame:(const Frame&)frameIn
+- (NSFramePreview*) initFromFrame:(const Frame&)frameIn withWidth:(const int)width
 {
     frameNumber = frameIn.getFrameNumberHumanReadable();
     timeStamp   = [NSString fromStdString:frameIn.gettimeStampString()];
     
-    Mat cvMat;
-    cv::cvtColor(frameIn.getData(), cvMat, cv::COLOR_RGB2BGR); // Convert from BGR to RGB
+    Mat cvMat = frameIn.getData(width); // Already in RGB order, so can be used as it is
+    if (cvMat.empty())
+        return self; // No image
 
-    NSData* data = [NSData dataWithBytes:cvMat.data length:cvMat.elemSize()*cvMat.total()];
     CGColorSpaceRef colorSpace;
 
     if (cvMat.elemSize() == 1)
@@ -49,7 +49,11 @@
     else
         colorSpace = CGColorSpaceCreateDeviceRGB();
 
-    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)data);
+    // The image reads the pixels straight out of the frame, rather than a copy of them. The provider keeps
+    // its own reference to the frame's data, which is released once the image no longer needs it
+    Mat* pixels = new Mat(cvMat);
+    CGDataProviderRef provider = CGDataProviderCreateWithData(pixels, pixels->data, pixels->step[0]*pixels->rows,
+                                                              [](void* info, const void*, size_t) { delete static_cast<Mat*>(info); });
 
     CGImageRef imageRef = CGImageCreate(cvMat.cols,                                 //width
                                         cvMat.rows,                                 //height
@@ -92,10 +96,11 @@
 {
     std::string filePathStdStr = [filePath getStdString];
     vp = std::make_shared<VideoPreview>(filePathStdStr);
+    vp->setDisplayScale([[NSScreen mainScreen] backingScaleFactor]); // Frames are stored at the size they are shown at on this display
     
     try {
+        [self loadConfig   ]; // Before the video, which is opened with the library set by the "video_backend" option
         [self loadVideo    ]; // Throws a FileException if file could not be loaded
-        [self loadConfig   ];
         [self updatePreview];
     } catch (const FileException& exception) {
         std::cerr<< exception.what();
@@ -163,17 +168,49 @@
 - (NSNumber*) getRows                                                  { return [NSNumber numberWithInt: vp->getRowsInPreview()]; }
 - (NSNumber*) getCols                                                  { return [NSNumber numberWithInt: vp->getColsInPreview()]; }
 
+- (void) setViewportFirstRow:(const int)firstRow lastRow:(const int)lastRow cols:(const int)cols velocity:(const double)velocity
+{
+    vp->setViewport(firstRow, lastRow, cols, velocity);
+}
+
 - (NSNumber*) getNumOfFrames                                           { return [NSNumber numberWithUnsignedLong: vp->getNumOfFrames()]; }
+- (NSNumber*) getFramesVersion                                         { return [NSNumber numberWithUnsignedLong: vp->getFramesVersion()]; }
+- (NSNumber*) getCompleteness                                          { return [NSNumber numberWithDouble: vp->getCompleteness()]; }
 
-- (NSArray<NSFramePreview*>*) getFrames
+// Returns an array consisting of a NSFramePreview for each of `frames`, sized for the "frame_size" option
+- (NSArray<NSFramePreview*>*) toNSFrames:(const vector<Frame>&)frames
 {
-    vector<Frame> frames = vp->getFrames();
     NSMutableArray* nsFrames = [NSMutableArray new];
+    int             width    = vp->getDisplayedFrameWidth();
     
     for (Frame frame: frames)
-        [nsFrames addObject: [[NSFramePreview alloc] initFromFrame: frame]];
+        [nsFrames addObject: [[NSFramePreview alloc] initFromFrame: frame withWidth: width]];
     
     return nsFrames;
 }
 
+- (NSArray<NSFramePreview*>*) getFrames    { return [self toNSFrames: vp->getFrames()]; }
+
+- (void) selectFrame:(const int)frameNumber
+{
+    vp->selectFrame(frameNumber - 1); // NSFramePreview gives human readable frame numbers
+}
+
+- (NSArray<NSFramePreview*>*) zoomInFrom:(const int)firstFrameNumber to:(const int)lastFrameNumber
+{
+    return [self toNSFrames: vp->zoomIn(firstFrameNumber - 1, lastFrameNumber - 1)]; // NSFramePreview gives human readable frame numbers
+}
+
+- (NSArray<NSFramePreview*>*) zoomOut      { return [self toNSFrames: vp->zoomOut()]; }
+- (NSNumber*)                 getZoomDepth { return [NSNumber numberWithUnsignedLong: vp->getZoomDepth()]; }
+
+- (NSFramePreview*) stepSelectedFrame:(const int)offset
+{
+    std::optional<Frame> frame = vp->stepSelectedFrame(offset);
+    if (!frame)
+        return nil;
+    
+    return [[NSFramePreview alloc] initFromFrame: frame.value() withWidth: vp->getDisplayedFrameWidth()];
+}
+
 @end
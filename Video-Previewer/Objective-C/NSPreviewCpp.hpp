@@ -18,6 +18,6 @@ class Frame;
 
 @interface NSFramePreview (cpp_compatibility)
 
-- (instancetype) initFromFrame:(const Frame&)frameIn;
+- (instancetype) initFromFrame:(const Frame&)frameIn withWidth:(const int)width; // Uses the level of the frame's pyramid closest to `width` pixels wide
 
 @end
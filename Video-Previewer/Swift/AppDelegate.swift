@@ -27,6 +27,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
         dialog.showsResizeIndicator    = true
         dialog.showsHiddenFiles        = true
         dialog.allowedFileTypes        = ["public.movie"] // Only allow user to open files conforming to public.movie UTI
+        dialog.canChooseDirectories    = true             // A folder of numbered images is opened as an image sequence
         
         // The following loop runs indefinitely until the "break" condition inside is reached (or
         // the user presses the "Cancel" button. In practice the loop only runs once unless the
@@ -55,7 +56,7 @@ class AppDelegate: NSObject, NSApplicationDelegate {
                 // The following code only runs if no frames were loaded (probably because the file loaded was not a video)
                 let alert = NSAlert.init()
                 alert.messageText = "Could not load frames from file"
-                alert.informativeText = "Please open a valid video file. Note that image files cannot be previewed."
+                alert.informativeText = "Please open a valid video file, or a folder of numbered images. Note that single image files cannot be previewed."
                 alert.addButton(withTitle: "OK")
                 alert.runModal()
             }
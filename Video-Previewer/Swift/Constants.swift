@@ -23,8 +23,10 @@ let previewPadding           = 15.0                  // The padding around the f
 let scrollBarWidth           = 15.0                  // The width of a scrollbar in a ScrollView
 let sidePanelWidth           = 300.0                 // The miniumum width of the side panel
 
-let minFrameWidth            = 100.0                 // The minimum width of a frame in the preview
-let maxFrameWidth            = 500.0                 // The maximum width of a frame in the preview
+let minFrameWidth            = 100.0                 // The minimum width of a frame in the preview (also assumed by the backend's GUIInformation)
+let maxFrameWidth            = 500.0                 // The maximum width of a frame in the preview (also assumed by the backend's GUIInformation)
+
+let progressRefreshInterval  = 0.25                  // How often (in seconds) frames are reloaded while the backend is still making them
 
 
 let pasteBoard               = NSPasteboard.general  // For copy-and-pasting
@@ -13,6 +13,9 @@ struct ContentView: View {
     @EnvironmentObject private var preview:  PreviewData
     @EnvironmentObject private var settings: UserSettings
     
+    // While the backend is still filling in the preview in the background, new frames are loaded at this interval
+    private let progressTimer = Timer.publish(every: progressRefreshInterval, on: .main, in: .common).autoconnect()
+    
     var body: some View {
         
         GeometryReader { geometry in
@@ -72,6 +75,11 @@ struct ContentView: View {
                     SidePanelView().frame(width: CGFloat(sidePanelWidth))
                 }
             }
+            .onReceive(progressTimer) { _ in
+                if (preview.backend!.getCompleteness()!.doubleValue < 1.0 || preview.backend!.getFramesVersion()!.intValue != preview.loadedFramesVersion) {
+                    preview.refresh()
+                }
+            }
         }
     }
 }
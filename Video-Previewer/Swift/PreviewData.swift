@@ -18,10 +18,73 @@ class PreviewData: ObservableObject {
     // meaningful, but updating its value causes any View with a PreviewData member will be updated.
     @Published var updateCounter: Int = 0
     
+    // The version of the backend's frames that are currently loaded into `frames`
+    private var framesVersion: Int = -1
+    var loadedFramesVersion:   Int { return framesVersion }
+    
+    // The value of "frame_size" when `frames` was loaded (the backend gives images sized for it)
+    private var framesSize: Double = -1.0
+    
+    // The rows of the preview that are on screen, which are reported to the backend so that it can decode them first
+    private var visibleRows:         Set<Int> = []
+    private var lastFirstVisibleRow: Int      = 0
+    private var lastViewportChange:  Date     = Date()
+    
+    func rowAppeared(_ row: Int, cols: Int) {
+        visibleRows.insert(row)
+        updateViewport(cols: cols)
+    }
+    
+    func rowDisappeared(_ row: Int, cols: Int) {
+        visibleRows.remove(row)
+        updateViewport(cols: cols)
+    }
+    
+    private func updateViewport(cols: Int) {
+        guard let firstRow = visibleRows.min(), let lastRow = visibleRows.max() else { return }
+        
+        // Scroll velocity in rows per second (positive when scrolling down)
+        let now      = Date()
+        let elapsed  = now.timeIntervalSince(lastViewportChange)
+        let velocity = elapsed > 0 ? Double(firstRow - lastFirstVisibleRow) / elapsed : 0.0
+        
+        lastFirstVisibleRow = firstRow
+        lastViewportChange  = now
+        
+        backend!.setViewportFirstRow(Int32(firstRow), lastRow: Int32(lastRow), cols: Int32(cols), velocity: velocity)
+    }
+    
+    // Select a frame, and have the backend decode the frames around it so that stepping to them is instant
+    func selectFrame(_ frame: NSFramePreview?) {
+        selectedFrame = frame
+        if (frame != nil) {
+            backend!.selectFrame(frame!.getFrameNumber())
+        }
+    }
+    
+    // Move the selection to a neighbouring frame of the video (which needn't be one of the frames in the preview)
+    func stepSelectedFrame(by offset: Int) {
+        if let frame = backend!.stepSelectedFrame(Int32(offset)) {
+            selectedFrame = frame
+        }
+    }
+    
     func refresh() {
-        // Update the frames array if it contains a different number of frames than is required
-        if (frames!.count != backend!.getNumOfFrames()!.intValue) {
-            frames = backend!.getFrames()
+        let frameSize: Double = backend!.getOptionValue("frame_size")!.getDouble()!.doubleValue
+        
+        // Update the frames array if the backend has made a new set of frames
+        if (frames!.count != backend!.getNumOfFrames()!.intValue || framesVersion != backend!.getFramesVersion()!.intValue) {
+            frames        = backend!.getFrames()
+            framesVersion = backend!.getFramesVersion()!.intValue
+            framesSize    = frameSize
+        }
+        
+        // The frames are the same but are shown at a different size, so load images of that size (without decoding anything)
+        else if (frameSize != framesSize) {
+            let selectedFrameNumber = selectedFrame?.getFrameNumber()
+            frames        = backend!.getFrames()
+            framesSize    = frameSize
+            selectedFrame = frames!.first(where: { $0?.getFrameNumber() == selectedFrameNumber }) ?? nil
         }
         
         // Refresh all relevant views
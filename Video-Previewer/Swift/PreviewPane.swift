@@ -58,10 +58,10 @@ struct FramePreviewView: View {
         }
         .onTapGesture {
             if (preview.selectedFrame != nil && preview.selectedFrame?.getFrameNumber() == frame.getFrameNumber()) {
-                preview.selectedFrame = nil      // If this frame is selected
+                preview.selectFrame(nil)         // If this frame is selected
                 return
             }
-            preview.selectedFrame = self.frame  // If either no frame or a different frame is selected
+            preview.selectFrame(self.frame)     // If either no frame or a different frame is selected
         }
     }
 }
@@ -91,7 +91,7 @@ struct PreviewPaneView: View {
                 
                 HStack(alignment: .center) {
                     Spacer()
-                    VStack(alignment:.center, spacing: CGFloat(settings.previewSpaceBetweenRows)){
+                    LazyVStack(alignment:.center, spacing: CGFloat(settings.previewSpaceBetweenRows)){ // Lazy, so that rows only appear when they are scrolled to
                         ForEach(0..<rows, id: \.self) { i in
                             HStack(spacing: 0) {
                                 ForEach(0..<cols, id: \.self) { j in
@@ -105,11 +105,21 @@ struct PreviewPaneView: View {
                                     }
                                 }
                             }
+                            .onAppear    { preview.rowAppeared(i, cols: cols) }    // Tell the backend which rows to decode first
+                            .onDisappear { preview.rowDisappeared(i, cols: cols) }
                         }
                     }.padding([.vertical], CGFloat(previewPadding)) // No need to pad horizontally because the width of the view takes that into account
                     Spacer()
                 }
             }
         }
+        .focusable()
+        .onMoveCommand { direction in // Step the selection through the neighbouring frames of the video with the arrow keys
+            switch direction {
+                case .left:  preview.stepSelectedFrame(by: -1)
+                case .right: preview.stepSelectedFrame(by: 1)
+                default:     break
+            }
+        }
     }
 }
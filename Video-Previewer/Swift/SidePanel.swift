@@ -155,6 +155,25 @@ struct AdvancedConfigSection: View {
             ConfigRowView(option: preview.backend!.getOptionInformation("minimum_sampling")!)
                 .disabled( maximumFramesString == nil )
                 .foregroundColor(maximumFramesString == nil ? colorFaded : colorBold)
+            
+            Divider()
+            
+            Text("Sampling frames at keyframes is much faster for long videos, at the cost of the frames not being exactly evenly spaced. The fast scan engine only ever decodes keyframes, and is faster still.")
+                .fixedSize(horizontal: false, vertical: true) // For multiline text wrapping
+                .multilineTextAlignment(.leading)
+                .noteFont()
+            
+            ConfigRowView(option: preview.backend!.getOptionInformation("sampling_mode")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("sampling_schedule")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("video_backend")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("default_fps")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("decode_engine")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("progressive_preview")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("extraction_threads")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("time_budget_ms")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("decode_timeout_ms")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("thumbnail_width")!)
+            ConfigRowView(option: preview.backend!.getOptionInformation("prefetch_window")!)
         }
     }
 }